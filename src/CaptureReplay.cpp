@@ -0,0 +1,63 @@
+#include "CaptureReplay.hpp"
+
+#include <QDebug>
+
+
+#define REPLAY_SLICE_MSECS 10
+
+
+CaptureReplay::CaptureReplay(const QString &captureFileName,
+                             TelemetryStream *stream, double speed) :
+    m_stream(stream),
+    m_speed(speed),
+    m_timer(this)
+{
+    m_open = m_reader.open(captureFileName);
+    if (!m_open)
+        qWarning() << "Could not open capture" << captureFileName;
+    
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(replayDue()));
+    if (stream->readerThread())
+        moveToThread(stream->readerThread());
+}
+
+
+void
+CaptureReplay::start()
+{
+    if (!m_open)
+        return;
+    
+    m_haveChunk = m_reader.readChunk(m_chunkTime, m_chunk);
+    m_clock.start();
+    replayDue();
+}
+
+
+void
+CaptureReplay::replayDue()
+{
+    QElapsedTimer slice;
+    slice.start();
+    
+    while (m_haveChunk) {
+        if (m_speed > 0) {
+            qint64 wait = (m_chunkTime / m_speed - m_clock.nsecsElapsed())
+                / 1000000;
+            if (wait > 0) {
+                m_timer.start(wait);
+                return;
+            }
+        } else if (slice.elapsed() >= REPLAY_SLICE_MSECS) {
+            //Let the event loop breathe at maximum speed
+            m_timer.start(0);
+            return;
+        }
+        
+        m_stream->ingest(m_chunk.constData(), m_chunk.size());
+        m_haveChunk = m_reader.readChunk(m_chunkTime, m_chunk);
+    }
+    
+    emit finished();
+}
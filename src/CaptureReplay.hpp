@@ -0,0 +1,47 @@
+#ifndef CAPTUREREPLAY_HPP
+#define CAPTUREREPLAY_HPP
+
+
+#include "TelemetryStream.hpp"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+
+/* Pushes the chunks of a raw capture, byte for byte, through the framing,
+ * checksum and parsing of a stream, with their original spacing scaled by
+ * the given speed, or as fast as possible with a speed of 0. It runs in the
+ * thread the stream reads in.
+ */
+class CaptureReplay : public QObject
+{
+    Q_OBJECT
+    
+public:
+    CaptureReplay(const QString &captureFileName, TelemetryStream *stream,
+                  double speed=1);
+    bool isOpen() const {return m_open;}
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+protected:
+    TelemetryStream *m_stream;
+    CaptureReader m_reader;
+    bool m_open, m_haveChunk = false;
+    double m_speed;
+    qint64 m_chunkTime = 0;
+    QByteArray m_chunk;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+
+protected slots:
+    void replayDue();
+};
+
+
+#endif // CAPTUREREPLAY_HPP
@@ -0,0 +1,270 @@
+#ifndef FRAMESCHEMA_HPP
+#define FRAMESCHEMA_HPP
+
+
+#include "FrameValidation.hpp"
+
+#include <cmath>
+
+
+#define EMS_MESSAGE_BODY_SIZE 119
+#define EFIS_MESSAGE_BODY_SIZE 51
+#define MESSAGE_CHECKSUM_SIZE 2
+
+#define DEGREE_SIGN "\xC2\xB0"
+
+
+/* Layout of one fixed-width field of a Dynon serial frame. Decimal and Hex
+ * fields are scaled by multiplier / divisor. Fields with an altLabel carry
+ * one of two variables, depending on bit 0 of the frame's status field.
+ */
+struct FieldSpec
+{
+    enum Kind {Decimal, Hex, GeneralPurpose, Reserved};
+
+    constexpr FieldSpec(int offset, int width, Kind kind,
+                        int multiplier=1, int divisor=1,
+                        const char *label=0, const char *units=0,
+                        const char *altLabel=0, const char *altUnits=0) :
+        offset(offset), width(width), kind(kind),
+        multiplier(multiplier), divisor(divisor), label(label), units(units),
+        altLabel(altLabel), altUnits(altUnits) {}
+
+    int offset, width;
+    Kind kind;
+    int multiplier, divisor;
+    const char *label, *units;
+    const char *altLabel, *altUnits;
+};
+
+
+/* Meaning of an EMS general purpose field, selected by its 3-letter code. */
+struct GeneralPurposeSpec
+{
+    const char *code;
+    int multiplier, divisor;
+    const char *label, *units;
+};
+
+
+constexpr FieldSpec EMS_SCHEMA[] = {
+    {0, 2, FieldSpec::Decimal, 1, 1, "hour", "h"},
+    {2, 2, FieldSpec::Decimal, 1, 1, "minute", "min"},
+    {4, 2, FieldSpec::Decimal, 1, 1, "second", "s"},
+    {6, 2, FieldSpec::Decimal, 1, 64, "millisecond", "ms"},
+    {8, 4, FieldSpec::Decimal, 1, 100, "manifold pressure", "inHg"},
+    {12, 3, FieldSpec::Decimal, 1, 1, "oil temperature", DEGREE_SIGN "F"},
+    {15, 3, FieldSpec::Decimal, 1, 1, "oil pressure", "PSI"},
+    {18, 3, FieldSpec::Decimal, 1, 10, "fuel pressure", "PSI"},
+    {21, 3, FieldSpec::Decimal, 1, 10, "voltage", "V"},
+    {24, 3, FieldSpec::Decimal, 1, 1, "current", "A"},
+    {27, 3, FieldSpec::Decimal, 10, 1, "RPM", "RPM"},
+    {30, 3, FieldSpec::Decimal, 1, 10, "fuel flow", "GPH"},
+    {33, 4, FieldSpec::Decimal, 1, 10, "remaining fuel", "gal"},
+    {37, 3, FieldSpec::Decimal, 1, 10, "fuel level 1", "gal"},
+    {40, 3, FieldSpec::Decimal, 1, 10, "fuel level 2", "gal"},
+    {43, 8, FieldSpec::GeneralPurpose},
+    {51, 8, FieldSpec::GeneralPurpose},
+    {59, 8, FieldSpec::GeneralPurpose},
+    {67, 4, FieldSpec::Decimal, 1, 1,
+     "general purpose thermocouple", DEGREE_SIGN "F"},
+    {71, 4, FieldSpec::Decimal, 1, 1, "egt1", DEGREE_SIGN "F"},
+    {75, 4, FieldSpec::Decimal, 1, 1, "egt2", DEGREE_SIGN "F"},
+    {79, 4, FieldSpec::Decimal, 1, 1, "egt3", DEGREE_SIGN "F"},
+    {83, 4, FieldSpec::Decimal, 1, 1, "egt4", DEGREE_SIGN "F"},
+    {87, 4, FieldSpec::Decimal, 1, 1, "egt5", DEGREE_SIGN "F"},
+    {91, 4, FieldSpec::Decimal, 1, 1, "egt6", DEGREE_SIGN "F"},
+    {95, 3, FieldSpec::Decimal, 1, 1, "cht1", DEGREE_SIGN "F"},
+    {98, 3, FieldSpec::Decimal, 1, 1, "cht2", DEGREE_SIGN "F"},
+    {101, 3, FieldSpec::Decimal, 1, 1, "cht3", DEGREE_SIGN "F"},
+    {104, 3, FieldSpec::Decimal, 1, 1, "cht4", DEGREE_SIGN "F"},
+    {107, 3, FieldSpec::Decimal, 1, 1, "cht5", DEGREE_SIGN "F"},
+    {110, 3, FieldSpec::Decimal, 1, 1, "cht6", DEGREE_SIGN "F"},
+    {113, 1, FieldSpec::Decimal, 1, 1, "contact 1", ""},
+    {114, 1, FieldSpec::Decimal, 1, 1, "contact 2", ""},
+    {115, 2, FieldSpec::Reserved}, //Product ID
+};
+
+constexpr GeneralPurposeSpec EMS_GENERAL_PURPOSE[] = {
+    {"OAT", 1, 1, "OAT", DEGREE_SIGN "F"},
+    {"CRB", 1, 1, "carburator temperature", DEGREE_SIGN "F"},
+    {"CLT", 1, 1, "coolant temperature", DEGREE_SIGN "F"},
+    {"CLP", 1, 1, "coolant pressure", "psi"},
+    {"FL3", 1, 10, "fuel level 3", "gal"},
+    {"FL4", 1, 10, "fuel level 4", "gal"},
+    {"CHT", 1, 1, "cylinder head temperature", DEGREE_SIGN "F"},
+    {"TRA", 1, 1, "aileron trim", "%"},
+    {"TRE", 1, 1, "elevator trim", "%"},
+    {"TRR", 1, 1, "rudder trim", "%"},
+    {"FLP", 1, 1, "flap position", DEGREE_SIGN},
+};
+
+constexpr FieldSpec EFIS_SCHEMA[] = {
+    {0, 2, FieldSpec::Decimal, 1, 1, "hour", "h"},
+    {2, 2, FieldSpec::Decimal, 1, 1, "minute", "min"},
+    {4, 2, FieldSpec::Decimal, 1, 1, "second", "s"},
+    {6, 2, FieldSpec::Decimal, 1, 64, "millisecond", "ms"},
+    {8, 4, FieldSpec::Decimal, 1, 10, "pitch", DEGREE_SIGN},
+    {12, 5, FieldSpec::Decimal, 1, 10, "roll", DEGREE_SIGN},
+    {17, 3, FieldSpec::Decimal, 1, 1, "yaw", DEGREE_SIGN},
+    {20, 4, FieldSpec::Decimal, 1, 10, "airspeed", "m/s"},
+    {24, 5, FieldSpec::Decimal, 1, 1, "pressure altitude", "m",
+     "displayed altitude", "m"},
+    {29, 4, FieldSpec::Decimal, 1, 10, "turn rate", DEGREE_SIGN "/s",
+     "vertical speed", "ft/s"},
+    {33, 3, FieldSpec::Decimal, 1, 100, "lateral acceleration", "g"},
+    {36, 3, FieldSpec::Decimal, 1, 10, "vertical acceleration", "g"},
+    {39, 2, FieldSpec::Decimal, 1, 1, "angle of attack", "% of stall"},
+    {41, 6, FieldSpec::Hex}, //Status bitmask
+    {47, 2, FieldSpec::Reserved}, //Product ID
+};
+
+/* Characters that may appear in a payload: decimal digits, signs and blank
+ * padding, plus letters for the EMS general purpose codes and unavailable
+ * ('X') fields and hex digits of either case for the EFIS status bitmask, as
+ * accepted by decodeHex.
+ */
+constexpr CharRange EMS_CHARACTERS[] = {
+    {'0', '9'}, {'A', 'Z'}, {'+', '+'}, {'-', '-'}, {' ', ' '}
+};
+
+constexpr CharRange EFIS_CHARACTERS[] = {
+    {'0', '9'}, {'A', 'F'}, {'a', 'f'}, {'X', 'X'}, {'+', '+'}, {'-', '-'},
+    {' ', ' '}
+};
+
+constexpr int EMS_FIELD_COUNT = sizeof(EMS_SCHEMA) / sizeof(EMS_SCHEMA[0]);
+constexpr int EMS_GENERAL_PURPOSE_COUNT =
+    sizeof(EMS_GENERAL_PURPOSE) / sizeof(EMS_GENERAL_PURPOSE[0]);
+constexpr int EFIS_FIELD_COUNT = sizeof(EFIS_SCHEMA) / sizeof(EFIS_SCHEMA[0]);
+constexpr int EFIS_STATUS_FIELD = 13;
+constexpr int EMS_CHARACTER_RANGES =
+    sizeof(EMS_CHARACTERS) / sizeof(EMS_CHARACTERS[0]);
+constexpr int EFIS_CHARACTER_RANGES =
+    sizeof(EFIS_CHARACTERS) / sizeof(EFIS_CHARACTERS[0]);
+
+
+constexpr bool
+schemaContiguous(const FieldSpec *fields, int count, int offset)
+{
+    return count == 0 || (fields[0].offset == offset &&
+                          schemaContiguous(fields + 1, count - 1,
+                                           offset + fields[0].width));
+}
+
+
+constexpr int
+schemaPayloadSize(const FieldSpec *fields, int count)
+{
+    return fields[count - 1].offset + fields[count - 1].width;
+}
+
+
+static_assert(schemaContiguous(EMS_SCHEMA, EMS_FIELD_COUNT, 0),
+              "EMS schema fields must be contiguous");
+static_assert(schemaPayloadSize(EMS_SCHEMA, EMS_FIELD_COUNT) +
+              MESSAGE_CHECKSUM_SIZE == EMS_MESSAGE_BODY_SIZE,
+              "EMS schema does not match the message body size");
+static_assert(schemaContiguous(EFIS_SCHEMA, EFIS_FIELD_COUNT, 0),
+              "EFIS schema fields must be contiguous");
+static_assert(schemaPayloadSize(EFIS_SCHEMA, EFIS_FIELD_COUNT) +
+              MESSAGE_CHECKSUM_SIZE == EFIS_MESSAGE_BODY_SIZE,
+              "EFIS schema does not match the message body size");
+static_assert(EFIS_SCHEMA[EFIS_STATUS_FIELD].kind == FieldSpec::Hex,
+              "EFIS status field must be hexadecimal");
+
+
+/* Decode a fixed-width ASCII decimal field in place. Dynon pads the fields with
+ * leading zeros and an optional '+' or '-' sign; fields that are blank or
+ * hold anything else (e.g. 'XXX' for an unavailable sensor) decode as NaN.
+ */
+inline double
+decodeDecimal(const char *field, unsigned len)
+{
+    unsigned i = 0;
+    while (i < len && field[i] == ' ')
+        i++;
+
+    bool negative = false;
+    if (i < len && (field[i] == '+' || field[i] == '-'))
+        negative = field[i++] == '-';
+
+    unsigned firstDigit = i;
+    long value = 0;
+    for (; i < len && field[i] >= '0' && field[i] <= '9'; i++)
+        value = 10 * value + (field[i] - '0');
+    if (i == firstDigit)
+        return NAN;
+
+    while (i < len && field[i] == ' ')
+        i++;
+    if (i != len)
+        return NAN;
+
+    return negative ? -value : value;
+}
+
+
+/* Decode a fixed-width ASCII hexadecimal field in place, 0 if malformed. */
+inline long
+decodeHex(const char *field, unsigned len)
+{
+    long value = 0;
+    for (unsigned i = 0; i < len; i++) {
+        char c = field[i];
+        if (c >= '0' && c <= '9')
+            value = 16 * value + (c - '0');
+        else if (c >= 'A' && c <= 'F')
+            value = 16 * value + (c - 'A' + 10);
+        else if (c >= 'a' && c <= 'f')
+            value = 16 * value + (c - 'a' + 10);
+        else
+            return 0;
+    }
+
+    return value;
+}
+
+
+/* Decode the numeric value of a field; general purpose fields decode the
+ * value that follows their code, reserved fields decode as NaN.
+ */
+inline double
+decodeField(const FieldSpec &field, const char *payload)
+{
+    switch (field.kind) {
+    case FieldSpec::Decimal:
+        return (decodeDecimal(payload + field.offset, field.width)
+                * field.multiplier / field.divisor);
+    case FieldSpec::Hex:
+        return decodeHex(payload + field.offset, field.width);
+    case FieldSpec::GeneralPurpose:
+        return decodeDecimal(payload + field.offset + 3, field.width - 3);
+    default:
+        return NAN;
+    }
+}
+
+
+/* Decode every field of a schema, unrolled at compile time so that each
+ * offset, width and scale becomes a constant of the generated code.
+ */
+template <const FieldSpec *schema, int index, int count>
+struct SchemaDecoder
+{
+    static inline void decode(const char *payload, double *values)
+    {
+        values[index] = decodeField(schema[index], payload);
+        SchemaDecoder<schema, index + 1, count>::decode(payload, values);
+    }
+};
+
+
+template <const FieldSpec *schema, int count>
+struct SchemaDecoder<schema, count, count>
+{
+    static inline void decode(const char *, double *) {}
+};
+
+
+#endif // FRAMESCHEMA_HPP
@@ -0,0 +1,98 @@
+#include "FrameValidation.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+static bool charAllowed(char c, const CharRange *ranges, int numRanges);
+
+
+/* Sum the bytes of a payload modulo 256 and check that each of them falls in
+ * one of the allowed ranges, in a single pass over the data. The vector
+ * paths compare 32 (AVX2) or 16 (SSE2) bytes against every range at once and
+ * accumulate the sum with SAD against zero; the scalar loop handles the tail.
+ */
+bool
+sumAndValidate(const char *data, int size, const CharRange *ranges,
+               int numRanges, quint8 &sum)
+{
+    int i = 0;
+    quint64 total = 0;
+    
+#if defined(__AVX2__)
+    __m256i totals = _mm256_setzero_si256();
+    __m256i invalid = _mm256_setzero_si256();
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i allowed = _mm256_setzero_si256();
+        for (int r = 0; r < numRanges; r++) {
+            //Bytes >= 0x80 compare as negative and are never allowed
+            __m256i aboveFirst = _mm256_cmpgt_epi8(
+                chunk, _mm256_set1_epi8(ranges[r].first - 1));
+            __m256i belowLast = _mm256_cmpgt_epi8(
+                _mm256_set1_epi8(ranges[r].last + 1), chunk);
+            allowed = _mm256_or_si256(
+                allowed, _mm256_and_si256(aboveFirst, belowLast));
+        }
+        invalid = _mm256_or_si256(
+            invalid, _mm256_xor_si256(allowed, _mm256_set1_epi8(-1)));
+        totals = _mm256_add_epi64(
+            totals, _mm256_sad_epu8(chunk, _mm256_setzero_si256()));
+    }
+    if (!_mm256_testz_si256(invalid, invalid))
+        return false;
+    
+    quint64 lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, totals);
+    total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128i totals = _mm_setzero_si128();
+    __m128i invalid = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i allowed = _mm_setzero_si128();
+        for (int r = 0; r < numRanges; r++) {
+            //Bytes >= 0x80 compare as negative and are never allowed
+            __m128i aboveFirst = _mm_cmpgt_epi8(
+                chunk, _mm_set1_epi8(ranges[r].first - 1));
+            __m128i belowLast = _mm_cmpgt_epi8(
+                _mm_set1_epi8(ranges[r].last + 1), chunk);
+            allowed = _mm_or_si128(allowed,
+                                   _mm_and_si128(aboveFirst, belowLast));
+        }
+        invalid = _mm_or_si128(invalid,
+                               _mm_xor_si128(allowed, _mm_set1_epi8(-1)));
+        totals = _mm_add_epi64(totals,
+                               _mm_sad_epu8(chunk, _mm_setzero_si128()));
+    }
+    if (_mm_movemask_epi8(invalid) != 0)
+        return false;
+    
+    quint64 lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, totals);
+    total += lanes[0] + lanes[1];
+#endif
+    
+    for (; i < size; i++) {
+        if (!charAllowed(data[i], ranges, numRanges))
+            return false;
+        total += (quint8) data[i];
+    }
+    
+    sum = total;
+    return true;
+}
+
+
+static bool
+charAllowed(char c, const CharRange *ranges, int numRanges)
+{
+    for (int r = 0; r < numRanges; r++)
+        if (c >= ranges[r].first && c <= ranges[r].last)
+            return true;
+    
+    return false;
+}
@@ -0,0 +1,19 @@
+#ifndef FRAMEVALIDATION_HPP
+#define FRAMEVALIDATION_HPP
+
+
+#include <QtGlobal>
+
+
+/* Inclusive range of characters allowed in a frame payload. */
+struct CharRange
+{
+    char first, last;
+};
+
+
+bool sumAndValidate(const char *data, int size, const CharRange *ranges,
+                    int numRanges, quint8 &sum);
+
+
+#endif // FRAMEVALIDATION_HPP
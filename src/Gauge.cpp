@@ -1,16 +1,29 @@
 #include "Gauge.hpp"
+#include "LatencyTrace.hpp"
 
 #include <QtGlobal>
 #include <QFont>
 #include <QGraphicsSvgItem>
 #include <QGraphicsSimpleTextItem>
+#include <QLineF>
 #include <QLocale>
+#include <QMutex>
+#include <QPainter>
+#include <QRunnable>
+#include <QStyleOptionGraphicsItem>
+#include <QThreadPool>
 #include <QDebug>
 
 #include <algorithm>
+#include <climits>
 #include <cmath>
 
 
+#define RASTER_SETTLE_MSECS 150 //Quiet time after a resize before rasterizing
+#define RASTER_LEVELS_PER_OCTAVE 4
+#define MAX_RASTER_LEVELS 3 //Kept per gauge
+
+
 typedef enum {
     AnchorTop, AnchorBottom, AnchorLeft, AnchorRight,
     AnchorTopLeft, AnchorTopRight, AnchorBottomLeft, AnchorBottomRight,
@@ -18,12 +31,128 @@ typedef enum {
 } AnchorPoint;
 
 static QPointF bottomCenter(const QRectF &rect);
+static void paintItemTree(QPainter *painter, QGraphicsItem *item,
+                          QStyleOptionGraphicsItem *option, QWidget *widget);
+static QRectF gaugeBoundingRect(const QGraphicsItem *item);
 static void anchorItem(QGraphicsItem *item, AnchorPoint anchor, 
                        const QPointF &anchorPoint);
 
+//Elements looked up by the gauges, whatever the image
+static const char * const gaugeElementIds[] = {
+    "background", "foreground", "needle", "pivot", "rangeBand", "cursor",
+    "cursorRange", "majorTick", "minorTick", "tickLabel", "valueLabel",
+    "topLabel", "bottomLabel"
+};
+
+
+/* Where raster jobs leave their layers for the gauge, which is cleared
+ * when the gauge goes away so that late jobs have nobody to notify.
+ */
+struct RasterInbox
+{
+    QMutex mutex;
+    QObject *gauge;
+    
+    struct Result
+    {
+        int level;
+        quint64 generation;
+        double scale;
+        QImage underlay, overlay;
+    };
+    QList<Result> results;
+};
+
+
+//Plays the recorded layers back into images, in a pool thread
+class RasterJob : public QRunnable
+{
+public:
+    QSharedPointer<RasterInbox> inbox;
+    QPicture underlay, overlay;
+    QRectF viewBox;
+    int level;
+    quint64 generation;
+    
+    virtual void run();
+};
+
+
+void
+RasterJob::run()
+{
+    RasterInbox::Result result;
+    result.level = level;
+    result.generation = generation;
+    result.scale = std::exp2((double) level / RASTER_LEVELS_PER_OCTAVE);
+    
+    QSize size(std::ceil(viewBox.width() * result.scale),
+               std::ceil(viewBox.height() * result.scale));
+    for (auto layer: {qMakePair(&underlay, &result.underlay),
+                      qMakePair(&overlay, &result.overlay)}) {
+        QImage &image = *layer.second;
+        image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        
+        QPainter painter(&image);
+        painter.scale(result.scale, result.scale);
+        painter.translate(-viewBox.topLeft());
+        painter.drawPicture(0, 0, *layer.first);
+    }
+    
+    QMutexLocker lock(&inbox->mutex);
+    if (!inbox->gauge)
+        return;
+    
+    inbox->results.append(result);
+    QMetaObject::invokeMethod(inbox->gauge, "takeRasterLayers",
+                              Qt::QueuedConnection);
+}
+
+
+SvgDocument::SvgDocument(const QString &svgFile) :
+    m_renderer(svgFile), m_viewBox(m_renderer.viewBoxF())
+{
+    for (auto elementId: gaugeElementIds)
+        boundsOnElement(elementId);
+}
+
+
+QSharedPointer<SvgDocument>
+SvgDocument::load(const QString &svgFile)
+{
+    //Gauges are built in the GUI thread only
+    static QHash<QString, QWeakPointer<SvgDocument>> documents;
+    
+    QSharedPointer<SvgDocument> document =
+        documents.value(svgFile).toStrongRef();
+    if (!document) {
+        document = QSharedPointer<SvgDocument>(new SvgDocument(svgFile));
+        documents.insert(svgFile, document);
+    }
+    
+    return document;
+}
+
+
+QRectF
+SvgDocument::boundsOnElement(const QString &elementId)
+{
+    auto bounds = m_bounds.constFind(elementId);
+    if (bounds != m_bounds.constEnd())
+        return *bounds;
+    
+    //Missing elements are remembered too, as empty bounds
+    QRectF elementBounds;
+    if (m_renderer.elementExists(elementId))
+        elementBounds = m_renderer.boundsOnElement(elementId);
+    m_bounds.insert(elementId, elementBounds);
+    return elementBounds;
+}
+
 
 SvgGauge::SvgGauge(const QString &svgFile, QWidget *parent) :
-    QGraphicsView(parent), m_renderer(svgFile)
+    QGraphicsView(parent), m_svg(SvgDocument::load(svgFile))
 {
     setScene(new QGraphicsScene(this));
     setStyleSheet("background: transparent");
@@ -31,8 +160,66 @@ SvgGauge::SvgGauge(const QString &svgFile, QWidget *parent) :
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
-    setSceneRect(m_renderer.viewBoxF());
+    setSceneRect(m_svg->viewBox());
     //setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Minimum);
+    
+    //Everything hangs from the root, so a dashboard can take it all over
+    m_root = new QGraphicsRectItem(m_svg->viewBox());
+    m_root->setFlag(QGraphicsItem::ItemHasNoContents);
+    scene()->addItem(m_root);
+    
+    m_rasterInbox = QSharedPointer<RasterInbox>(new RasterInbox);
+    m_rasterInbox->gauge = this;
+    m_rasterTimer.setSingleShot(true);
+    m_rasterTimer.setInterval(RASTER_SETTLE_MSECS);
+    connect(&m_rasterTimer, SIGNAL(timeout()),
+            this, SLOT(buildRasterLayers()));
+}
+
+
+SvgGauge::~SvgGauge()
+{
+    //Jobs still running finish into an inbox nobody reads
+    m_rasterInbox->mutex.lock();
+    m_rasterInbox->gauge = 0;
+    m_rasterInbox->mutex.unlock();
+    
+    //The root may live in a dashboard scene rather than the gauge's own
+    delete m_root;
+}
+
+
+void
+SvgGauge::addToGauge(QGraphicsItem *item)
+{
+    //Static until addDynamicItem says otherwise, shown through the layers
+    item->setParentItem(m_root);
+    item->setVisible(!m_layered);
+    invalidateLayers();
+}
+
+
+void
+SvgGauge::moveToScene(QGraphicsScene *target, const QRectF &cell)
+{
+    //Layers are a per-view cache, the dashboard view paints every item
+    setLayeredRendering(false);
+    
+    QRectF viewBox = m_svg->viewBox();
+    qreal scale = std::min(cell.width() / viewBox.width(),
+                           cell.height() / viewBox.height());
+    m_root->setScale(scale);
+    m_root->setPos(cell.center() - scale * viewBox.center());
+    target->addItem(m_root);
+}
+
+
+qint64
+SvgGauge::takePaintArrival()
+{
+    qint64 arrival = m_paintArrival;
+    m_paintArrival = 0;
+    return arrival;
 }
 
 
@@ -40,25 +227,290 @@ QGraphicsSvgItem*
 SvgGauge::addItemFromElement(const QString &elementId, qreal zValue)
 {
     QGraphicsSvgItem *element = new QGraphicsSvgItem;
-    element->setSharedRenderer(&m_renderer);
+    element->setSharedRenderer(m_svg->renderer());
     element->setElementId(elementId);
-    element->setPos(m_renderer.boundsOnElement(elementId).topLeft());
+    element->setPos(m_svg->boundsOnElement(elementId).topLeft());
     element->setZValue(zValue);
     
-    scene()->addItem(element);
+    addToGauge(element);
     
     return element;
 }
 
 
+void
+SvgGauge::setLayeredRendering(bool layered)
+{
+    m_layered = layered;
+    invalidateLayers();
+    
+    for (auto item: m_root->childItems())
+        item->setVisible(!layered || m_dynamicItems.contains(item));
+    if (!layered)
+        m_underlay = m_overlay = QPicture();
+}
+
+
+void
+SvgGauge::addDynamicItem(QGraphicsItem *item)
+{
+    m_dynamicItems.append(item);
+    item->setVisible(true);
+    invalidateLayers();
+}
+
+
+double
+SvgGauge::pixelsPerUnit() const
+{
+    //Device pixels per gauge unit in whichever view shows the gauge
+    QGraphicsScene *shownIn = m_root->scene();
+    if (!shownIn || shownIn->views().isEmpty())
+        return 0;
+    
+    QGraphicsView *view = shownIn->views().first();
+    QTransform transform = m_root->sceneTransform() * view->transform();
+    return std::sqrt(std::abs(transform.determinant()))
+        * view->devicePixelRatioF();
+}
+
+
+bool
+SvgGauge::visibleMove(double displacement) const
+{
+    //Unknown scales and NaN displacements always count as visible
+    double scale = pixelsPerUnit();
+    return scale <= 0 || !(displacement * scale < m_pixelDeadband);
+}
+
+
+void
+SvgGauge::invalidateLayers()
+{
+    //Results of jobs already started are dropped when they come in
+    m_layersValid = false;
+    m_rasterLevels.clear();
+    m_shownLayers = RasterLayers();
+    m_rasterGeneration++;
+    viewport()->update();
+}
+
+
+void
+SvgGauge::recordLayers()
+{
+    qreal splitZ = -INFINITY;
+    for (auto item: m_dynamicItems)
+        splitZ = std::max(splitZ, item->zValue());
+    
+    m_underlay = m_overlay = QPicture();
+    QPainter underPainter(&m_underlay), overPainter(&m_overlay);
+    underPainter.setRenderHints(renderHints());
+    overPainter.setRenderHints(renderHints());
+    QStyleOptionGraphicsItem option;
+    
+    //Static items, hidden from the scene, are recorded here in scene
+    //coordinates, in stacking order on whichever side of the dynamic items
+    //they belong. childItems() is already sorted by stacking order
+    for (auto item: m_root->childItems()) {
+        if (m_dynamicItems.contains(item))
+            continue;
+        
+        QPainter &painter = item->zValue() > splitZ ? overPainter
+                                                    : underPainter;
+        paintItemTree(&painter, item, &option, viewport());
+    }
+    
+    m_layersValid = true;
+}
+
+
+int
+SvgGauge::rasterLevel() const
+{
+    //Rounded up, rasters are only ever scaled down
+    double scale = pixelsPerUnit();
+    if (!(scale > 0))
+        return INT_MIN;
+    
+    return std::ceil(std::log2(scale) * RASTER_LEVELS_PER_OCTAVE);
+}
+
+
+bool
+SvgGauge::rasterCurrent() const
+{
+    return m_rasterLevels.contains(rasterLevel());
+}
+
+
+void
+SvgGauge::buildRasterLayers()
+{
+    if (!m_layered || !m_layersValid || m_rasterBuilding
+        || rasterLevel() == INT_MIN || rasterCurrent())
+        return;
+    
+    RasterJob *job = new RasterJob;
+    job->inbox = m_rasterInbox;
+    //Deep copies: playing a picture seeks its buffer, shared by shallow
+    //copies, and the vector fallback may play these meanwhile
+    job->underlay.setData(m_underlay.data(), m_underlay.size());
+    job->overlay.setData(m_overlay.data(), m_overlay.size());
+    job->viewBox = m_svg->viewBox();
+    job->level = rasterLevel();
+    job->generation = m_rasterGeneration;
+    m_rasterBuilding = true;
+    QThreadPool::globalInstance()->start(job);
+}
+
+
+void
+SvgGauge::takeRasterLayers()
+{
+    m_rasterInbox->mutex.lock();
+    QList<RasterInbox::Result> results = m_rasterInbox->results;
+    m_rasterInbox->results.clear();
+    m_rasterInbox->mutex.unlock();
+    
+    for (const auto &result: results) {
+        m_rasterBuilding = false;
+        if (result.generation != m_rasterGeneration)
+            continue;
+        
+        RasterLayers layers;
+        layers.underlay = QPixmap::fromImage(result.underlay);
+        layers.overlay = QPixmap::fromImage(result.overlay);
+        layers.scale = result.scale;
+        m_rasterLevels.insert(result.level, layers);
+        
+        //Make room by dropping the level farthest from this one
+        while (m_rasterLevels.size() > MAX_RASTER_LEVELS) {
+            int farthest = result.level;
+            for (int level: m_rasterLevels.keys()) {
+                if (qAbs(level - result.level) > qAbs(farthest - result.level))
+                    farthest = level;
+            }
+            m_rasterLevels.remove(farthest);
+        }
+    }
+    
+    //The size may have changed again while the job ran
+    viewport()->update();
+}
+
+
+void
+SvgGauge::drawLayer(QPainter *painter, const QPixmap &raster,
+                    const QPicture &vector)
+{
+    //The painter is in scene coordinates, those the layers were recorded in
+    if (raster.isNull()) {
+        painter->drawPicture(0, 0, vector);
+        return;
+    }
+    
+    QRectF viewBox = m_svg->viewBox();
+    QRectF source(QPointF(0, 0), viewBox.size() * m_shownLayers.scale);
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    painter->drawPixmap(viewBox, raster, source);
+    painter->restore();
+}
+
+
+void
+SvgGauge::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    if (!m_layered) {
+        QGraphicsView::drawBackground(painter, rect);
+        return;
+    }
+    
+    drawLayer(painter, m_shownLayers.underlay, m_underlay);
+}
+
+
+void
+SvgGauge::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    if (!m_layered) {
+        QGraphicsView::drawForeground(painter, rect);
+        return;
+    }
+    
+    drawLayer(painter, m_shownLayers.overlay, m_overlay);
+}
+
+
+void
+SvgGauge::traceValueChange()
+{
+    //Paint latency is that of the oldest value not yet on screen
+    qint64 arrival = LatencyTrace::applyingArrival();
+    if (arrival && (!m_paintArrival || arrival < m_paintArrival))
+        m_paintArrival = arrival;
+}
+
+
+void
+SvgGauge::paintEvent(QPaintEvent *event)
+{
+    if (m_layered) {
+        if (!m_layersValid)
+            recordLayers();
+        
+        //The level for this size, else the closest larger one, else vector
+        int wanted = rasterLevel();
+        int best = INT_MAX;
+        for (int level: m_rasterLevels.keys()) {
+            if (level >= wanted && level < best)
+                best = level;
+        }
+        m_shownLayers = m_rasterLevels.value(best);
+        
+        //Restarted by every paint of a resize, so it only fires once settled
+        if (best != wanted && !m_rasterBuilding)
+            m_rasterTimer.start();
+    }
+    
+    QGraphicsView::paintEvent(event);
+    LatencyTrace::record(PaintStage, takePaintArrival());
+}
+
+
 void
 SvgGauge::resizeEvent(QResizeEvent *event)
 {
+    //The layers follow on the next paint, no need to record them again
     fitInView(sceneRect(), Qt::KeepAspectRatio);
     QGraphicsView::resizeEvent(event);
 }
 
 
+void
+TickedSvgGauge::configure(const GaugeSpec &spec)
+{
+    Q_ASSERT(spec.valueMin <= spec.valueMax);
+    
+    setTextColor(spec.textColor);
+    setValueLabelFormat(spec.valueLabelFormat, spec.valueLabelPrecision);
+    m_valueMin = spec.valueMin;
+    m_valueMax = spec.valueMax;
+    m_numMajorTicks = spec.numMajorTicks;
+    m_numMinorTicks = spec.numMinorTicks;
+    
+    //Lays out the minor ticks too
+    updateMajorTicks();
+    
+    //The spec replaces any bands of an earlier configuration
+    qDeleteAll(m_rangeBands);
+    m_rangeBands.clear();
+    for (const auto &band: spec.rangeBands)
+        addRangeBand(band.color, band.startValue, band.endValue);
+}
+
+
 void
 TickedSvgGauge::setNumMajorTicks(unsigned newNumMajorTicks)
 {
@@ -83,6 +535,7 @@ TickedSvgGauge::setTextColor(const QColor &newColor)
         tickLabel->setBrush(m_textColor);
     for (auto textLabel: m_textLabels)
         textLabel->setBrush(m_textColor);
+    invalidateLayers();
 }
     
 
@@ -91,6 +544,7 @@ TickedSvgGauge::setValueLabelFormat(char f, int precision)
 {
     m_valueLabelFormat = f;
     m_valueLabelPrecision = precision;
+    m_valueText.clear();
 }
 
 
@@ -122,7 +576,22 @@ TickedSvgGauge::updateMajorTicks()
     for (unsigned i = 0; i < m_numMajorTicks; i++)
         placeMajorTick(m_valueMin + i * valueIncrement);
 
-    void updateMinorTicks();
+    updateMinorTicks();
+}
+
+
+bool
+TickedSvgGauge::setValueText(double value)
+{
+    //Text layout is skipped when the formatted value is unchanged
+    QString text = QLocale().toString(value, m_valueLabelFormat,
+                                      m_valueLabelPrecision);
+    if (text == m_valueText)
+        return false;
+    
+    m_valueText = text;
+    m_valueLabel->setText(text);
+    return true;
 }
 
 
@@ -131,7 +600,8 @@ TickedSvgGauge::updateMinorTicks()
 {
     for (auto minorTick: m_minorTicks)
         delete minorTick;
-    m_majorTicks.clear();
+    m_minorTicks.clear();
+    invalidateLayers();
 
     if (m_numMinorTicks == 0 || m_numMajorTicks < 2)
         return;
@@ -140,7 +610,8 @@ TickedSvgGauge::updateMinorTicks()
     double majorIncrement = majorRange / std::max(m_numMajorTicks - 1, 1u);
     double minorIncrement = majorIncrement / (m_numMinorTicks + 1);
     
-    for (unsigned i = 0; i < m_numMajorTicks; i++)
+    //Only between major ticks, none past the last one
+    for (unsigned i = 0; i + 1 < m_numMajorTicks; i++)
         for (unsigned j = 0; j < m_numMinorTicks; j++)
             placeMinorTick(m_valueMin + i * majorIncrement + 
                            (j + 1) * minorIncrement);
@@ -150,8 +621,8 @@ TickedSvgGauge::updateMinorTicks()
 AngularSvgGauge::AngularSvgGauge(const QString &svgFile, QWidget *parent) :
     TickedSvgGauge(svgFile, parent)
 {
-    m_pivot = m_renderer.boundsOnElement("pivot").center();
-    auto rangeBandRect = m_renderer.boundsOnElement("rangeBand");
+    m_pivot = m_svg->boundsOnElement("pivot").center();
+    auto rangeBandRect = m_svg->boundsOnElement("rangeBand");
     m_rangeBandInnerRadius = rangeBandRect.bottom() - m_pivot.y();
     m_rangeBandOuterRadius = rangeBandRect.top() - m_pivot.y();
     
@@ -160,7 +631,34 @@ AngularSvgGauge::AngularSvgGauge(const QString &svgFile, QWidget *parent) :
     m_foreground = addItemFromElement("foreground", ForegroundLayer);
     
     m_valueLabel = addLabelFromElement("", "valueLabel");
-    m_valueLabelCenter = m_renderer.boundsOnElement("valueLabel").center();
+    m_valueLabelCenter = m_svg->boundsOnElement("valueLabel").center();
+    
+    //Distance from the pivot to the farthest point of the needle
+    QRectF needleRect = gaugeBoundingRect(m_needle);
+    m_needleRadius = 0;
+    for (auto corner: {needleRect.topLeft(), needleRect.topRight(),
+                       needleRect.bottomLeft(), needleRect.bottomRight()})
+        m_needleRadius = std::max(m_needleRadius,
+                                  QLineF(m_pivot, corner).length());
+    
+    addDynamicItem(m_needle);
+    if (m_valueLabel)
+        addDynamicItem(m_valueLabel);
+}
+
+
+void
+AngularSvgGauge::configure(const GaugeSpec &spec)
+{
+    Q_ASSERT(spec.angleMin <= spec.angleMax);
+    
+    //Ticks and range bands are placed by angle
+    m_angleMin = spec.angleMin;
+    m_angleMax = spec.angleMax;
+    TickedSvgGauge::configure(spec);
+    
+    setBottomLabel(spec.bottomLabel);
+    setTopLabel(spec.topLabel);
 }
 
 
@@ -187,7 +685,9 @@ AngularSvgGauge::addRangeBand(const QColor &color,
     band->setZValue(RangeBandLayer);
     band->setBrush(color);
     band->setPen(QPen(Qt::NoPen));
-    scene()->addItem(band);
+    addToGauge(band);
+    m_rangeBands.append(band);
+    invalidateLayers();
 }
 
 
@@ -204,26 +704,55 @@ AngularSvgGauge::setAngleRange(double angleMin, double angleMax)
 void
 AngularSvgGauge::setValue(double value)
 {
-    m_needle->setRotation(valueToAngle(value));
-    if (m_valueLabel) {
-        m_valueLabel->setText(QLocale().toString(value, m_valueLabelFormat,
-                                                 m_valueLabelPrecision));
+    bool changed = false;
+    
+    //Arc travelled by the needle tip
+    double angle = valueToAngle(value);
+    double arc = std::abs(angle - m_needle->rotation()) * M_PI / 180
+        * m_needleRadius;
+    if (visibleMove(arc)) {
+        m_needle->setRotation(angle);
+        changed = true;
+    }
+    
+    if (m_valueLabel && setValueText(value)) {
         anchorItem(m_valueLabel, AnchorCenter, m_valueLabelCenter);
+        changed = true;
     }
+    
+    if (changed)
+        traceValueChange();
 }
 
 
 void
 AngularSvgGauge::setBottomLabel(const QString &text)
 {
-    addLabelFromElement(text, "bottomLabel");
+    replaceLabel(m_bottomLabel, text, "bottomLabel");
 }
 
 
 void
 AngularSvgGauge::setTopLabel(const QString &text)
 {
-    addLabelFromElement(text, "topLabel");
+    replaceLabel(m_topLabel, text, "topLabel");
+}
+
+
+void
+AngularSvgGauge::replaceLabel(QGraphicsSimpleTextItem *&label,
+                              const QString &text, const QString &elementId)
+{
+    //An empty text only removes the label
+    if (label) {
+        m_textLabels.removeOne(label);
+        delete label;
+        label = 0;
+        invalidateLayers();
+    }
+    
+    if (!text.isEmpty())
+        label = addLabelFromElement(text, elementId);
 }
 
 
@@ -231,7 +760,7 @@ QGraphicsSvgItem*
 AngularSvgGauge::addItemFromElement(const QString &elementId, qreal zValue)
 {
     auto element = TickedSvgGauge::addItemFromElement(elementId, zValue);
-    element->setTransformOriginPoint(element->mapFromScene(m_pivot));
+    element->setTransformOriginPoint(element->mapFromParent(m_pivot));
     
     return element;
 }
@@ -241,7 +770,7 @@ QGraphicsSimpleTextItem*
 AngularSvgGauge::addLabelFromElement(const QString &text, 
                                      const QString &elementId)
 {
-    QRectF labelRect = m_renderer.boundsOnElement(elementId);
+    QRectF labelRect = m_svg->boundsOnElement(elementId);
     if (labelRect.isEmpty())
         return 0;
     
@@ -253,8 +782,9 @@ AngularSvgGauge::addLabelFromElement(const QString &text,
     label->setBrush(m_textColor);
     label->setFont(labelFont);
     anchorItem(label, AnchorCenter, labelRect.center());
-    scene()->addItem(label);
+    addToGauge(label);
     m_textLabels.append(label);
+    invalidateLayers();
 
     return label;
 }
@@ -269,7 +799,7 @@ AngularSvgGauge::placeMajorTick(double value)
     tick->setRotation(angle);
     m_majorTicks.append(tick);
     
-    QRectF tickLabelRect = m_renderer.boundsOnElement("tickLabel");
+    QRectF tickLabelRect = m_svg->boundsOnElement("tickLabel");
     QFont tickLabelFont;
     tickLabelFont.setPixelSize(tickLabelRect.height());
     
@@ -278,32 +808,32 @@ AngularSvgGauge::placeMajorTick(double value)
     tickLabel->setFont(tickLabelFont);
     tickLabel->setBrush(m_textColor);
     tickLabel->setZValue(InfoLayer);
-    scene()->addItem(tickLabel);
+    addToGauge(tickLabel);
     m_majorTickLabels.append(tickLabel);
     
     if (angle < -135) {
-        QPointF anchorPoint = tick->sceneBoundingRect().topRight();
+        QPointF anchorPoint = gaugeBoundingRect(tick).topRight();
         anchorItem(tickLabel, AnchorBottom, anchorPoint);
     } else if (angle >= -135 && angle < -90) {
-        QPointF anchorPoint = tick->sceneBoundingRect().topRight();
+        QPointF anchorPoint = gaugeBoundingRect(tick).topRight();
         anchorItem(tickLabel, AnchorLeft, anchorPoint);
     } else if (angle >= -90 && angle < -45) {
-        QPointF anchorPoint = tick->sceneBoundingRect().bottomRight();
+        QPointF anchorPoint = gaugeBoundingRect(tick).bottomRight();
         anchorItem(tickLabel, AnchorLeft, anchorPoint);
     } else if (angle >= -45 && angle < 0) {
-        QPointF anchorPoint = tick->sceneBoundingRect().bottomRight();
+        QPointF anchorPoint = gaugeBoundingRect(tick).bottomRight();
         anchorItem(tickLabel, AnchorTop, anchorPoint);
     } else if (angle >= 0 && angle < 45) {
-        QPointF anchorPoint = tick->sceneBoundingRect().bottomLeft();
+        QPointF anchorPoint = gaugeBoundingRect(tick).bottomLeft();
         anchorItem(tickLabel, AnchorTop, anchorPoint);
     } else if (angle >= 45 && angle < 90) {
-        QPointF anchorPoint = tick->sceneBoundingRect().bottomLeft();
+        QPointF anchorPoint = gaugeBoundingRect(tick).bottomLeft();
         anchorItem(tickLabel, AnchorRight, anchorPoint);
     } else if (angle >= 90 && angle < 135) {
-        QPointF anchorPoint = tick->sceneBoundingRect().topLeft();
+        QPointF anchorPoint = gaugeBoundingRect(tick).topLeft();
         anchorItem(tickLabel, AnchorRight, anchorPoint);
     } else if (angle >= 135) {
-        QPointF anchorPoint = tick->sceneBoundingRect().topLeft();
+        QPointF anchorPoint = gaugeBoundingRect(tick).topLeft();
         anchorItem(tickLabel, AnchorBottom, anchorPoint);
     }
 }
@@ -339,7 +869,7 @@ AngularSvgGauge::valueToAngle(double value)
 LinearSvgGauge::LinearSvgGauge(const QString &svgFile, QWidget *parent) :
     TickedSvgGauge(svgFile, parent)
 {
-    m_cursorRange = m_renderer.boundsOnElement("cursorRange");
+    m_cursorRange = m_svg->boundsOnElement("cursorRange");
     m_startPos = m_cursorRange.left();
     m_endPos = m_cursorRange.right();
     
@@ -347,16 +877,19 @@ LinearSvgGauge::LinearSvgGauge(const QString &svgFile, QWidget *parent) :
     m_cursor = addItemFromElement("cursor", CursorLayer);
     m_foreground = addItemFromElement("foreground", ForegroundLayer);
 
-    m_valueLabelRect = m_renderer.boundsOnElement("valueLabel");
+    m_valueLabelRect = m_svg->boundsOnElement("valueLabel");
     m_valueLabel = new QGraphicsSimpleTextItem();
     m_valueLabel->setZValue(InfoLayer);
     m_valueLabel->setBrush(m_textColor);
-    scene()->addItem(m_valueLabel);
+    addToGauge(m_valueLabel);
     m_textLabels.append(m_valueLabel);
 
     QFont valueLabelFont;
     valueLabelFont.setPixelSize(m_valueLabelRect.height());
     m_valueLabel->setFont(valueLabelFont);
+    
+    addDynamicItem(m_cursor);
+    addDynamicItem(m_valueLabel);
 }
 
 
@@ -374,17 +907,32 @@ LinearSvgGauge::addRangeBand(const QColor &color,
     band->setZValue(BackgroundLayer);
     band->setBrush(color);
     band->setPen(QPen(Qt::NoPen));
-    scene()->addItem(band);
+    addToGauge(band);
+    m_rangeBands.append(band);
+    invalidateLayers();
 }
 
 
 void
 LinearSvgGauge::setValue(double value)
 {
-    moveToPos(m_cursor, valueToPos(value));
-    m_valueLabel->setText(QLocale().toString(value, m_valueLabelFormat, 
-                                             m_valueLabelPrecision));
-    anchorItem(m_valueLabel, AnchorBottomRight, m_valueLabelRect.bottomRight());
+    bool changed = false;
+    
+    double pos = valueToPos(value);
+    if (visibleMove(std::abs(pos - m_cursorPos))) {
+        moveToPos(m_cursor, pos);
+        m_cursorPos = pos;
+        changed = true;
+    }
+    
+    if (setValueText(value)) {
+        anchorItem(m_valueLabel, AnchorBottomRight,
+                   m_valueLabelRect.bottomRight());
+        changed = true;
+    }
+    
+    if (changed)
+        traceValueChange();
 }
 
 
@@ -396,7 +944,7 @@ LinearSvgGauge::placeMajorTick(double value)
     moveToPos(tick, pos);
     m_majorTicks.append(tick);
 
-    QRectF tickLabelRect = m_renderer.boundsOnElement("tickLabel");
+    QRectF tickLabelRect = m_svg->boundsOnElement("tickLabel");
     QFont tickLabelFont;
     tickLabelFont.setPixelSize(tickLabelRect.height());
     
@@ -405,10 +953,10 @@ LinearSvgGauge::placeMajorTick(double value)
     tickLabel->setText(QLocale().toString(value));
     tickLabel->setBrush(QColor(m_textColor));
     tickLabel->setZValue(InfoLayer);
-    scene()->addItem(tickLabel);
+    addToGauge(tickLabel);
     m_majorTickLabels.append(tickLabel);
     
-    QRectF tickBoundingRect = tick->sceneBoundingRect();
+    QRectF tickBoundingRect = gaugeBoundingRect(tick);
     if (value == m_valueMin)
         anchorItem(tickLabel, AnchorTopLeft, tickBoundingRect.bottomLeft());
     else
@@ -444,7 +992,111 @@ LinearSvgGauge::valueToPos(double value)
 void
 LinearSvgGauge::moveToPos(QGraphicsItem *item, double pos)
 {
-    item->setX(pos - item->sceneBoundingRect().width() / 2);
+    item->setX(pos - gaugeBoundingRect(item).width() / 2);
+}
+
+
+Dashboard::Dashboard(const QSizeF &size, QWidget *parent) :
+    QGraphicsView(parent)
+{
+    setScene(new QGraphicsScene(this));
+    setStyleSheet("background: transparent");
+    
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    
+    setSceneRect(QRectF(QPointF(0, 0), size));
+}
+
+
+Dashboard::~Dashboard()
+{
+    //The gauges delete their roots, which must still be in the scene: as
+    //a child created first, the scene would otherwise go before them
+    qDeleteAll(m_gauges);
+}
+
+
+void
+Dashboard::addGauge(SvgGauge *gauge, const QRectF &cell)
+{
+    //The gauge widget itself is never shown, it only owns the items
+    gauge->setParent(this);
+    gauge->hide();
+    gauge->moveToScene(scene(), cell);
+    m_gauges.append(gauge);
+}
+
+
+void
+Dashboard::addTitle(const QString &text, const QRectF &cell)
+{
+    QFont titleFont;
+    titleFont.setPixelSize(0.8 * cell.height());
+    
+    auto title = new QGraphicsSimpleTextItem(text);
+    title->setFont(titleFont);
+    title->setBrush(palette().color(QPalette::WindowText));
+    anchorItem(title, AnchorCenter, cell.center());
+    scene()->addItem(title);
+}
+
+
+void
+Dashboard::paintEvent(QPaintEvent *event)
+{
+    QGraphicsView::paintEvent(event);
+    for (auto gauge: m_gauges)
+        LatencyTrace::record(PaintStage, gauge->takePaintArrival());
+}
+
+
+void
+Dashboard::resizeEvent(QResizeEvent *event)
+{
+    fitInView(sceneRect(), Qt::KeepAspectRatio);
+    QGraphicsView::resizeEvent(event);
+}
+
+
+/* Paints an item and its descendants the way the scene would, whether the
+ * item is hidden or not: children stacked behind it first, opacity and
+ * clipping to shapes included. Items ignoring transformations are not
+ * supported.
+ */
+static void
+paintItemTree(QPainter *painter, QGraphicsItem *item,
+              QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    auto paintChildren = [&](bool behindParent) {
+        painter->save();
+        if (item->flags() & QGraphicsItem::ItemClipsChildrenToShape) {
+            painter->setTransform(item->sceneTransform());
+            painter->setClipPath(item->shape(), Qt::IntersectClip);
+        }
+        for (auto child: item->childItems()) {
+            bool behind = child->zValue() < 0
+                || (child->flags() & QGraphicsItem::ItemStacksBehindParent);
+            if (behind == behindParent && child->isVisibleTo(item))
+                paintItemTree(painter, child, option, widget);
+        }
+        painter->restore();
+    };
+    
+    paintChildren(true);
+    
+    if (!(item->flags() & QGraphicsItem::ItemHasNoContents)) {
+        painter->save();
+        painter->setTransform(item->sceneTransform());
+        painter->setOpacity(item->effectiveOpacity());
+        if (item->flags() & QGraphicsItem::ItemClipsToShape)
+            painter->setClipPath(item->shape(), Qt::IntersectClip);
+        option->exposedRect = item->boundingRect();
+        item->paint(painter, option, widget);
+        painter->restore();
+    }
+    
+    paintChildren(false);
 }
 
 
@@ -452,44 +1104,44 @@ static void
 anchorItem(QGraphicsItem *item, AnchorPoint anchor, 
            const QPointF &anchorPoint)
 {
-    QRectF sceneBoundingRect = item->sceneBoundingRect();
+    QRectF boundingRect = gaugeBoundingRect(item);
     
     switch (anchor) {
     case AnchorTop:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width() / 2);
+        item->setX(anchorPoint.x() - boundingRect.width() / 2);
         item->setY(anchorPoint.y());
         break;
     case AnchorBottom:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width() / 2);
-        item->setY(anchorPoint.y() - sceneBoundingRect.height());
+        item->setX(anchorPoint.x() - boundingRect.width() / 2);
+        item->setY(anchorPoint.y() - boundingRect.height());
         break;
     case AnchorLeft:
         item->setX(anchorPoint.x());
-        item->setY(anchorPoint.y() - sceneBoundingRect.height() / 2);
+        item->setY(anchorPoint.y() - boundingRect.height() / 2);
         break;
     case AnchorRight:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width());
-        item->setY(anchorPoint.y() - sceneBoundingRect.height() / 2);
+        item->setX(anchorPoint.x() - boundingRect.width());
+        item->setY(anchorPoint.y() - boundingRect.height() / 2);
         break;
     case AnchorTopLeft:
         item->setX(anchorPoint.x());
         item->setY(anchorPoint.y());
         break;
     case AnchorTopRight:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width());
+        item->setX(anchorPoint.x() - boundingRect.width());
         item->setY(anchorPoint.y());
         break;
     case AnchorBottomLeft:
         item->setX(anchorPoint.x());
-        item->setY(anchorPoint.y() - sceneBoundingRect.height());
+        item->setY(anchorPoint.y() - boundingRect.height());
         break;
     case AnchorBottomRight:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width());
-        item->setY(anchorPoint.y() - sceneBoundingRect.height());
+        item->setX(anchorPoint.x() - boundingRect.width());
+        item->setY(anchorPoint.y() - boundingRect.height());
         break;
     case AnchorCenter:
-        item->setX(anchorPoint.x() - sceneBoundingRect.width() / 2);
-        item->setY(anchorPoint.y() - sceneBoundingRect.height() / 2);
+        item->setX(anchorPoint.x() - boundingRect.width() / 2);
+        item->setY(anchorPoint.y() - boundingRect.height() / 2);
         break;
     }
 }
@@ -500,3 +1152,11 @@ bottomCenter(const QRectF &rect)
 {
     return QPointF(rect.center().x(), rect.bottom());
 }
+
+
+//Bounding rectangle in the coordinates of the gauge, wherever it is shown
+static QRectF
+gaugeBoundingRect(const QGraphicsItem *item)
+{
+    return item->mapRectToParent(item->boundingRect());
+}
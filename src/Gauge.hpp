@@ -3,32 +3,150 @@
 
 #include <QGraphicsSvgItem>
 #include <QGraphicsView>
+#include <QHash>
+#include <QPicture>
+#include <QPixmap>
 #include <QSharedPointer>
 #include <QSvgRenderer>
+#include <QTimer>
+#include <QVector>
 
+#include <cmath>
 
+
+//Needle and cursor moves smaller than this many device pixels are not shown
+#define DEFAULT_PIXEL_DEADBAND 0.5
+
+
+/* A parsed SVG file shared by every gauge drawn from it, released with the
+ * last one. Element bounds are memoized, the ids the gauges look up being
+ * computed once when the file is loaded.
+ */
+class SvgDocument
+{
+public:
+    static QSharedPointer<SvgDocument> load(const QString &svgFile);
+    QSvgRenderer * renderer() {return &m_renderer;}
+    QRectF viewBox() const {return m_viewBox;}
+    QRectF boundsOnElement(const QString &elementId);
+
+protected:
+    QSvgRenderer m_renderer;
+    QRectF m_viewBox;
+    QHash<QString, QRectF> m_bounds;
+    
+    explicit SvgDocument(const QString &svgFile);
+};
+
+
+struct RasterInbox;
+
+
+//Static layers of a gauge rasterized at one scale level
+struct RasterLayers
+{
+    QPixmap underlay, overlay;
+    double scale = 0;
+};
+
+
+/* In layered rendering, the default, items added to the gauge are static and
+ * hidden from the scene unless addDynamicItem() says otherwise. The static
+ * items are recorded into two pictures, one below and one above the dynamic
+ * items, recorded again only after the configuration changed. Once the size
+ * has settled, the pictures are rasterized in a worker thread at the scale
+ * level covering the current size, levels being a quarter of an octave
+ * apart. The last few levels are kept, so resizes and moves between screens
+ * mostly find their level ready. Repaints blit the best level available, or
+ * play the pictures back while none is, and paint the dynamic items alone.
+ */
 class SvgGauge : public QGraphicsView
 {
     Q_OBJECT
 
 public:
     SvgGauge(const QString &svgFile, QWidget *parent=0);
+    ~SvgGauge();
+    void setLayeredRendering(bool layered);
+    bool layeredRendering() const {return m_layered;}
+    void setPixelDeadband(double pixels) {m_pixelDeadband = pixels;}
+    void moveToScene(QGraphicsScene *target, const QRectF &cell);
+    qint64 takePaintArrival();
+
+protected slots:
+    void buildRasterLayers();
+    void takeRasterLayers();
 
 protected:
-    QSvgRenderer m_renderer;
+    QSharedPointer<SvgDocument> m_svg;
+    QGraphicsRectItem *m_root;
+    qint64 m_paintArrival = 0;
+    double m_pixelDeadband = DEFAULT_PIXEL_DEADBAND;
+    bool m_layered = true;
+    bool m_layersValid = false;
+    QPicture m_underlay, m_overlay;
+    QList<QGraphicsItem *> m_dynamicItems;
+    QHash<int, RasterLayers> m_rasterLevels;
+    RasterLayers m_shownLayers;
+    QSharedPointer<RasterInbox> m_rasterInbox;
+    QTimer m_rasterTimer;
+    quint64 m_rasterGeneration = 0;
+    bool m_rasterBuilding = false;
     
     QGraphicsSvgItem* addItemFromElement(const QString &elementId, 
                                          qreal zValue);
+    void addToGauge(QGraphicsItem *item);
+    void addDynamicItem(QGraphicsItem *item);
+    double pixelsPerUnit() const;
+    bool visibleMove(double displacement) const;
+    void invalidateLayers();
+    void recordLayers();
+    int rasterLevel() const;
+    bool rasterCurrent() const;
+    void traceValueChange();
+    void drawLayer(QPainter *painter, const QPixmap &raster,
+                   const QPicture &vector);
+    void drawBackground(QPainter *painter, const QRectF &rect);
+    void drawForeground(QPainter *painter, const QRectF &rect);
+    void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
 };
 
 
+/* Whole configuration of a ticked gauge, applied by configure() with a
+ * single tick layout pass. It replaces the range bands and labels of any
+ * earlier configuration. The angles and the top and bottom labels only
+ * apply to angular gauges.
+ */
+struct GaugeSpec
+{
+    struct RangeBand
+    {
+        QColor color;
+        double startValue, endValue;
+    };
+    
+    double valueMin = 0, valueMax = 1;
+    double angleMin = -90, angleMax = 90;
+    unsigned numMajorTicks = 0, numMinorTicks = 0;
+    QColor textColor = QColor("black");
+    char valueLabelFormat = 'g';
+    int valueLabelPrecision = 8;
+    QVector<RangeBand> rangeBands;
+    QString topLabel, bottomLabel;
+};
+
+
 class TickedSvgGauge : public SvgGauge
 {
     Q_OBJECT
     
 public:
     using SvgGauge::SvgGauge;
+    virtual void configure(const GaugeSpec &spec);
+    virtual void addRangeBand(const QColor &color, double startValue,
+                              double endValue) = 0;
+    virtual void setValue(double value) = 0;
     void setNumMajorTicks(unsigned newNumMajorTicks);
     void setNumMinorTicks(unsigned newNumMinorTicks);
     void setTextColor(const QColor &newColor);
@@ -41,14 +159,17 @@ protected:
     int m_valueLabelPrecision = 8;
     char m_valueLabelFormat = 'g';
     QColor m_textColor = QColor("black");
+    QString m_valueText;
     QList<QGraphicsSvgItem *> m_majorTicks;
     QList<QGraphicsSvgItem *> m_minorTicks;
     QList<QGraphicsSimpleTextItem *> m_majorTickLabels;
     QList<QGraphicsSimpleTextItem *> m_textLabels;
+    QList<QGraphicsItem *> m_rangeBands;
     QGraphicsSimpleTextItem *m_valueLabel = 0;
     
     void updateMajorTicks();
     void updateMinorTicks();
+    bool setValueText(double value);
     
     virtual void placeMajorTick(double value) = 0;
     virtual void placeMinorTick(double value) = 0;
@@ -61,6 +182,7 @@ class AngularSvgGauge : public TickedSvgGauge
     
 public:
     AngularSvgGauge(const QString &svgFile, QWidget *parent=0);
+    void configure(const GaugeSpec &spec);
     void addRangeBand(const QColor &color, double startValue, double endValue);
     void setAngleRange(double angleMin, double angleMax);
     void setValue(double value);
@@ -73,7 +195,9 @@ protected:
     };
     
     QGraphicsSvgItem *m_background, *m_needle, *m_foreground;
+    QGraphicsSimpleTextItem *m_topLabel = 0, *m_bottomLabel = 0;
     QPointF m_pivot, m_valueLabelCenter;
+    double m_needleRadius;
     double m_angleMin = -90, m_angleMax = 90;
     double m_rangeBandInnerRadius, m_rangeBandOuterRadius;
 
@@ -81,6 +205,8 @@ protected:
                                          qreal zValue);
     QGraphicsSimpleTextItem* addLabelFromElement(const QString &text,
                                                  const QString &elementId);
+    void replaceLabel(QGraphicsSimpleTextItem *&label, const QString &text,
+                      const QString &elementId);
     void placeMajorTick(double value);
     void placeMinorTick(double value);
     double valueToAngle(double value);    
@@ -104,6 +230,7 @@ protected:
     QGraphicsSvgItem *m_background, *m_cursor, *m_foreground;
     QRectF m_cursorRange, m_valueLabelRect;
     double m_startPos, m_endPos;
+    double m_cursorPos = NAN;
     
     void moveToPos(QGraphicsItem *item, double pos);
     void placeMajorTick(double value);
@@ -112,4 +239,27 @@ protected:
 };
 
 
+/* Every gauge in a single scene and view: one frame of updates is then one
+ * paint pass over the union of the regions that changed, instead of one
+ * per gauge. The gauges keep their whole API, only their items move into
+ * the dashboard, each scaled into a cell given in dashboard units.
+ */
+class Dashboard : public QGraphicsView
+{
+    Q_OBJECT
+
+public:
+    Dashboard(const QSizeF &size, QWidget *parent=0);
+    ~Dashboard();
+    void addGauge(SvgGauge *gauge, const QRectF &cell);
+    void addTitle(const QString &text, const QRectF &cell);
+
+protected:
+    QList<SvgGauge *> m_gauges;
+    
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+};
+
+
 #endif // GAUGE_HPP
@@ -0,0 +1,182 @@
+#include "LatencyTrace.hpp"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtAlgorithms>
+
+
+std::atomic<bool> LatencyTrace::s_enabled{false};
+LatencyHistogram LatencyTrace::s_histograms[LatencyStageCount];
+qint64 LatencyTrace::s_applyingArrival = 0;
+
+
+static QElapsedTimer startedClock();
+
+//Started before any stream exists, so real timestamps are never zero
+static const QElapsedTimer traceClock = startedClock();
+
+
+void
+LatencyHistogram::record(qint64 nsecs)
+{
+    if (nsecs < 0)
+        nsecs = 0;
+    
+    m_buckets[bucket(nsecs)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    
+    qint64 maximum = m_maximum.load(std::memory_order_relaxed);
+    while (nsecs > maximum
+           && !m_maximum.compare_exchange_weak(maximum, nsecs,
+                                               std::memory_order_relaxed))
+        ;
+}
+
+
+void
+LatencyHistogram::reset()
+{
+    for (auto &counter: m_buckets)
+        counter = 0;
+    m_count = 0;
+    m_maximum = 0;
+}
+
+
+qint64
+LatencyHistogram::percentile(double fraction) const
+{
+    quint64 total = m_count;
+    if (total == 0)
+        return 0;
+    
+    //Upper limit of the bucket holding the requested rank
+    quint64 rank = qMax<quint64>(1, fraction * total + 0.5);
+    quint64 seen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return qMin(bucketLimit(i), maximum());
+    }
+    
+    return maximum();
+}
+
+
+int
+LatencyHistogram::bucket(qint64 nsecs)
+{
+    if (nsecs < 4)
+        return nsecs;
+    
+    //Exponent and the two bits below the leading one
+    int exponent = 63 - qCountLeadingZeroBits(quint64(nsecs));
+    int sub = (nsecs >> (exponent - 2)) & 3;
+    return 4 * (exponent - 1) + sub;
+}
+
+
+qint64
+LatencyHistogram::bucketLimit(int bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    
+    int exponent = bucket / 4 + 1;
+    qint64 step = Q_INT64_C(1) << (exponent - 2);
+    return (4 + bucket % 4) * step + step - 1;
+}
+
+
+qint64
+LatencyTrace::now()
+{
+    return traceClock.nsecsElapsed();
+}
+
+
+void
+LatencyTrace::record(LatencyStage stage, qint64 arrival)
+{
+    if (arrival && enabled())
+        s_histograms[stage].record(now() - arrival);
+}
+
+
+const LatencyHistogram &
+LatencyTrace::histogram(LatencyStage stage)
+{
+    return s_histograms[stage];
+}
+
+
+const char *
+LatencyTrace::stageName(LatencyStage stage)
+{
+    switch (stage) {
+    case ChecksumStage:
+        return "checksum";
+    case ParseStage:
+        return "parse";
+    case UpdateStage:
+        return "update";
+    case SetValueStage:
+        return "setValue";
+    case PaintStage:
+        return "paint";
+    default:
+        return "";
+    }
+}
+
+
+void
+LatencyTrace::reset()
+{
+    for (auto &histogram: s_histograms)
+        histogram.reset();
+}
+
+
+QByteArray
+LatencyTrace::report()
+{
+    //Tab separated like the text logs, latencies in microseconds
+    QByteArray report("stage\tcount\tp50_us\tp99_us\tmax_us\n");
+    for (int i = 0; i < LatencyStageCount; i++) {
+        auto stage = LatencyStage(i);
+        const LatencyHistogram &stageHistogram = histogram(stage);
+        report += stageName(stage);
+        report += '\t' + QByteArray::number(stageHistogram.count());
+        report += '\t' + QByteArray::number(
+            stageHistogram.percentile(0.5) / 1e3, 'f', 1);
+        report += '\t' + QByteArray::number(
+            stageHistogram.percentile(0.99) / 1e3, 'f', 1);
+        report += '\t' + QByteArray::number(
+            stageHistogram.maximum() / 1e3, 'f', 1);
+        report += '\n';
+    }
+    
+    return report;
+}
+
+
+bool
+LatencyTrace::dump(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    
+    QByteArray contents = report();
+    return file.write(contents) == contents.size();
+}
+
+
+static QElapsedTimer
+startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
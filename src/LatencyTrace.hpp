@@ -0,0 +1,75 @@
+#ifndef LATENCYTRACE_HPP
+#define LATENCYTRACE_HPP
+
+
+#include <QString>
+
+#include <atomic>
+
+
+#define LATENCY_HISTOGRAM_BUCKETS 256
+
+
+//Points of a frame's way to the screen, each measured from the readyRead
+//that brought its bytes in
+enum LatencyStage {
+    ChecksumStage, ParseStage, UpdateStage, SetValueStage, PaintStage,
+    LatencyStageCount
+};
+
+
+/* Lock-free histogram of latencies in nanoseconds. Buckets are logarithmic
+ * with four sub-buckets per power of two, so percentiles are reported
+ * within 25% while the maximum is exact.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() {reset();}
+    void record(qint64 nsecs);
+    void reset();
+    quint64 count() const {return m_count;}
+    qint64 percentile(double fraction) const;
+    qint64 maximum() const {return m_maximum;}
+
+protected:
+    std::atomic<quint64> m_buckets[LATENCY_HISTOGRAM_BUCKETS];
+    std::atomic<quint64> m_count;
+    std::atomic<qint64> m_maximum;
+    
+    static int bucket(qint64 nsecs);
+    static qint64 bucketLimit(int bucket);
+};
+
+
+/* Optional end-to-end latency tracing. Streams timestamp every readyRead
+ * on a monotonic clock, the timestamp travels with the frame and each stage
+ * records how old it is when the stage finishes. Untraced frames carry a
+ * zero timestamp and cost a single branch per stage.
+ */
+class LatencyTrace
+{
+public:
+    static bool enabled() {return s_enabled.load(std::memory_order_relaxed);}
+    static void setEnabled(bool enabled) {s_enabled = enabled;}
+    static qint64 now();
+    static qint64 arrival() {return enabled() ? now() : 0;}
+    static void record(LatencyStage stage, qint64 arrival);
+    static const LatencyHistogram & histogram(LatencyStage stage);
+    static const char * stageName(LatencyStage stage);
+    static void reset();
+    static QByteArray report();
+    static bool dump(const QString &fileName);
+    
+    //GUI thread only: arrival of the value being handed to the gauges
+    static qint64 applyingArrival() {return s_applyingArrival;}
+    static void setApplyingArrival(qint64 arrival) {s_applyingArrival = arrival;}
+
+protected:
+    static std::atomic<bool> s_enabled;
+    static LatencyHistogram s_histograms[LatencyStageCount];
+    static qint64 s_applyingArrival;
+};
+
+
+#endif // LATENCYTRACE_HPP
@@ -0,0 +1,176 @@
+#include "LogSession.hpp"
+
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <cstring>
+
+
+#define DATE_FORMAT "yyyy-MM-dd_HH'h'mm'm'ss's'"
+
+
+//Closes, compresses and records one finished segment
+class SegmentJob : public QRunnable
+{
+public:
+    AsyncLogWriter *writer;
+    QDateTime start, end;
+    QString manifestFileName;
+    bool compress;
+    
+    virtual void run();
+};
+
+
+static QThreadPool *
+segmentPool()
+{
+    //A single thread, so that segments reach the manifest in order
+    static QThreadPool *pool = []{
+        QThreadPool *pool = new QThreadPool;
+        pool->setMaxThreadCount(1);
+        return pool;
+    }();
+    
+    return pool;
+}
+
+
+LogSession::LogSession(const QString &folder, const RotationPolicy &rotation) :
+    m_folder(folder),
+    m_rotation(rotation)
+{
+    QString date = QDateTime::currentDateTime().toString(DATE_FORMAT);
+    m_manifestFileName = folder + "/session_" + date + ".manifest";
+}
+
+
+QString
+LogSession::beginSegment(const QString &streamName, const QString &extension)
+{
+    QMutexLocker lock(&m_mutex);
+    QString date = QDateTime::currentDateTime().toString(DATE_FORMAT);
+    return QString("%1/%2_%3_%4%5").arg(m_folder).arg(streamName).arg(date)
+        .arg(++m_segmentCount, 3, 10, QChar('0')).arg(extension);
+}
+
+
+bool
+LogSession::segmentFull(qint64 segmentBytes, qint64 segmentMsecs) const
+{
+    if (m_rotation.maxBytes > 0 && segmentBytes >= m_rotation.maxBytes)
+        return true;
+    
+    return (m_rotation.maxSeconds > 0
+            && segmentMsecs >= m_rotation.maxSeconds * Q_INT64_C(1000));
+}
+
+
+void
+LogSession::finishSegment(AsyncLogWriter *writer, const QDateTime &segmentStart)
+{
+    SegmentJob *job = new SegmentJob;
+    job->writer = writer;
+    job->start = segmentStart;
+    job->end = QDateTime::currentDateTime();
+    job->manifestFileName = m_manifestFileName;
+    job->compress = m_rotation.compress;
+    segmentPool()->start(job);
+}
+
+
+void
+LogSession::waitForFinishedSegments()
+{
+    segmentPool()->waitForDone();
+}
+
+
+void
+SegmentJob::run()
+{
+    QString fileName = writer->fileName();
+    qint64 size = writer->size();
+    quint64 dropped = writer->droppedRecords();
+    delete writer; //Writes out, syncs and closes the file
+    
+    //The segment stays uncompressed if compressing it fails
+    QString stored = fileName;
+    QString compressedName = fileName + COMPRESSED_LOG_EXTENSION;
+    if (compress && compressLogSegment(fileName, compressedName)) {
+        QFile::remove(fileName);
+        stored = compressedName;
+    } else if (compress) {
+        QFile::remove(compressedName);
+    }
+    
+    QFile manifest(manifestFileName);
+    if (!manifest.open(QIODevice::Append | QIODevice::Text))
+        return;
+    
+    if (manifest.size() == 0)
+        manifest.write("%segment\tstart\tend\tbytes\tdropped records\n");
+    QString line("%1\t%2\t%3\t%4\t%5\n");
+    manifest.write(line.arg(QFileInfo(stored).fileName())
+                   .arg(start.toString(Qt::ISODate))
+                   .arg(end.toString(Qt::ISODate))
+                   .arg(size).arg(dropped).toUtf8());
+}
+
+
+bool
+compressLogSegment(const QString &fileName, const QString &compressedName)
+{
+    QFile input(fileName), output(compressedName);
+    if (!input.open(QIODevice::ReadOnly) || !output.open(QIODevice::WriteOnly))
+        return false;
+    
+    if (output.write(COMPRESSED_LOG_MAGIC, 4) != 4)
+        return false;
+    
+    while (!input.atEnd()) {
+        //A read error returns nothing without moving on, stop rather than spin
+        QByteArray data = input.read(COMPRESSED_LOG_BLOCK_SIZE);
+        if (data.isEmpty() || input.error() != QFileDevice::NoError)
+            return false;
+        
+        QByteArray block = qCompress(data);
+        quint32 size = qToLittleEndian<quint32>(block.size());
+        if (output.write(reinterpret_cast<const char*>(&size), sizeof size)
+            != sizeof size
+            || output.write(block) != block.size())
+            return false;
+    }
+    
+    return output.flush();
+}
+
+
+bool
+decompressLogSegment(const QString &compressedName, const QString &fileName)
+{
+    QFile input(compressedName), output(fileName);
+    if (!input.open(QIODevice::ReadOnly) || !output.open(QIODevice::WriteOnly))
+        return false;
+    
+    char magic[4];
+    if (input.read(magic, 4) != 4
+        || std::memcmp(magic, COMPRESSED_LOG_MAGIC, 4) != 0)
+        return false;
+    
+    quint32 size;
+    while (input.read(reinterpret_cast<char*>(&size), sizeof size)
+           == sizeof size) {
+        QByteArray block = input.read(qFromLittleEndian(size));
+        if (block.size() != (int) qFromLittleEndian(size))
+            return false;
+        QByteArray data = qUncompress(block);
+        if ((data.isEmpty() && !block.isEmpty())
+            || output.write(data) != data.size())
+            return false;
+    }
+    
+    return input.atEnd();
+}
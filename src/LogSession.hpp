@@ -0,0 +1,56 @@
+#ifndef LOGSESSION_HPP
+#define LOGSESSION_HPP
+
+
+#include "TelemetryLog.hpp"
+
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+
+
+#define COMPRESSED_LOG_MAGIC "TLQZ"
+#define COMPRESSED_LOG_BLOCK_SIZE (1024 * 1024)
+#define COMPRESSED_LOG_EXTENSION ".qz"
+
+
+//When to start a new segment, 0 disabling the limit
+struct RotationPolicy
+{
+    qint64 maxBytes = 64 * 1024 * 1024;
+    int maxSeconds = 3600;
+    bool compress = true;
+};
+
+
+/* The logs written into one folder since it was chosen, split into
+ * segments. Finished segments are closed, compressed and recorded in the
+ * session manifest by a background thread, so rotating never waits on the
+ * disk. Segments of several streams may share a session.
+ */
+class LogSession
+{
+public:
+    LogSession(const QString &folder, const RotationPolicy &rotation);
+    QString beginSegment(const QString &streamName, const QString &extension);
+    bool segmentFull(qint64 segmentBytes, qint64 segmentMsecs) const;
+    void finishSegment(AsyncLogWriter *writer, const QDateTime &segmentStart);
+    QString manifestFileName() const {return m_manifestFileName;}
+    static void waitForFinishedSegments();
+
+protected:
+    QString m_folder, m_manifestFileName;
+    RotationPolicy m_rotation;
+    QMutex m_mutex;
+    int m_segmentCount = 0;
+};
+
+
+//Block-wise qCompress framing: the magic, then for every block its
+//little-endian quint32 compressed size and the qCompress output
+bool compressLogSegment(const QString &fileName, const QString &compressedName);
+bool decompressLogSegment(const QString &compressedName,
+                          const QString &fileName);
+
+
+#endif // LOGSESSION_HPP
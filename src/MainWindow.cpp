@@ -2,7 +2,6 @@
 
 #include <QtGui>
 #include <QAction>
-#include <QDateTime>
 #include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFormLayout>
@@ -11,24 +10,137 @@
 #include <QSerialPortInfo>
 #include <QStatusBar>
 #include <QToolBar>
+#include <QtAlgorithms>
 #include <QVBoxLayout>
 
 #include <QDebug>
 
+#include <algorithm>
+#include <cmath>
+
+
+#define DEFAULT_DISPLAY_RATE 30 //Hz
+
+
+GaugeUpdater::GaugeUpdater(QObject *parent) :
+    QObject(parent)
+{
+    setDisplayRate(DEFAULT_DISPLAY_RATE);
+    connect(&m_displayTimer, SIGNAL(timeout()), this, SLOT(applyPending()));
+}
+
+
+void
+GaugeUpdater::setDisplayRate(int hertz)
+{
+    m_displayTimer.setInterval(1000 / qMax(hertz, 1));
+}
+
+
+void
+GaugeUpdater::update(const TelemetryFrame &frame)
+{
+    DispatchTable *table = 0;
+    for (auto &candidate: m_tables) {
+        if (candidate.variables == frame.variables)
+            table = &candidate;
+    }
+    if (!table)
+        return;
+    LatencyTrace::record(UpdateStage, frame.arrival);
+    
+    //Kept for every variable, to start gauges linked later from
+    for (quint64 bits = frame.changed; bits; bits &= bits - 1) {
+        int id = qCountTrailingZeroBits(bits);
+        table->latestValues[id] = frame.values[id];
+    }
+    
+    //Latest value wins, the gauges only see it on the next display tick
+    quint64 changed = frame.changed & table->linked;
+    for (quint64 bits = changed; bits; bits &= bits - 1) {
+        int id = qCountTrailingZeroBits(bits);
+        table->pendingValues[id] = frame.values[id];
+        table->pendingArrivals[id] = frame.arrival;
+    }
+    table->pending |= changed;
+    
+    if (changed && !m_displayTimer.isActive())
+        m_displayTimer.start();
+}
+
 
 void
-GaugeUpdater::update(const TelemetryVariable &var)
+GaugeUpdater::applyPending()
 {
-    for (auto &updater: m_updaters.values(var.label)) {
-        updater(var.value);
+    bool idle = true;
+    for (auto &table: m_tables) {
+        for (quint64 bits = table.pending; bits; bits &= bits - 1) {
+            int id = qCountTrailingZeroBits(bits);
+            double value = table.pendingValues[id];
+            if (value == table.appliedValues[id])
+                continue;
+            
+            table.appliedValues[id] = value;
+            LatencyTrace::setApplyingArrival(table.pendingArrivals[id]);
+            for (const auto &updater: table.updaters[id])
+                updater(value);
+            LatencyTrace::record(SetValueStage, table.pendingArrivals[id]);
+        }
+        
+        idle = idle && !table.pending;
+        table.pending = 0;
     }
+    LatencyTrace::setApplyingArrival(0);
+    
+    //Stop ticking once a whole period went by without new values
+    if (idle)
+        m_displayTimer.stop();
+}
+
+
+void
+GaugeUpdater::attach(TelemetryStream *stream)
+{
+    DispatchTable table;
+    table.variables = stream->variables();
+    table.updaters.resize(table.variables->size());
+    table.linked = table.pending = 0;
+    std::fill_n(table.appliedValues, MAX_FRAME_VARIABLES, NAN);
+    std::fill_n(table.latestValues, MAX_FRAME_VARIABLES, NAN);
+    std::fill_n(table.pendingArrivals, MAX_FRAME_VARIABLES, 0);
+    for (const auto &link: m_links)
+        resolve(table, link.first, link.second);
+    m_tables.append(table);
+    
+    connect(stream, SIGNAL(frameReceived(const TelemetryFrame &)),
+            this, SLOT(update(const TelemetryFrame &)));
 }
 
 
 void
 GaugeUpdater::link(const QString &label, updater updater)
 {
-    m_updaters.insertMulti(label, updater);
+    m_links.append(qMakePair(label, updater));
+    for (auto &table: m_tables) {
+        //Gauges of pages built late start from the last value received
+        int id = resolve(table, label, updater);
+        if (id >= 0 && !std::isnan(table.latestValues[id]))
+            updater(table.latestValues[id]);
+    }
+}
+
+
+int
+GaugeUpdater::resolve(DispatchTable &table, const QString &label,
+                      updater updater)
+{
+    int id = table.variables->indexOf(label);
+    if (id < 0)
+        return id;
+    
+    table.updaters[id].append(updater);
+    table.linked |= Q_UINT64_C(1) << id;
+    return id;
 }
 
 
@@ -38,6 +150,26 @@ Settings::Settings() :
     m_emsPort = m_storedSettings.value("ems_port").toString();
     m_efisPort = m_storedSettings.value("efis_port").toString();
     m_logFolder = m_storedSettings.value("log_folder").toString();
+    m_displayRate = m_storedSettings.value("display_rate",
+                                           DEFAULT_DISPLAY_RATE).toInt();
+    m_binaryLog = m_storedSettings.value("binary_log", false).toBool();
+    m_logPolicy.flushInterval = m_storedSettings.value(
+        "log_flush_interval", m_logPolicy.flushInterval).toInt();
+    m_logPolicy.syncInterval = m_storedSettings.value(
+        "log_sync_interval", m_logPolicy.syncInterval).toInt();
+    m_rotationPolicy.maxBytes = m_storedSettings.value(
+        "log_segment_bytes", m_rotationPolicy.maxBytes).toLongLong();
+    m_rotationPolicy.maxSeconds = m_storedSettings.value(
+        "log_segment_seconds", m_rotationPolicy.maxSeconds).toInt();
+    m_rotationPolicy.compress = m_storedSettings.value(
+        "log_compress", m_rotationPolicy.compress).toBool();
+    m_captureRaw = m_storedSettings.value("capture_raw", false).toBool();
+    m_traceLatency = m_storedSettings.value("trace_latency", false).toBool();
+    m_dashboardMode = m_storedSettings.value("dashboard_mode", false).toBool();
+    m_pixelDeadband = m_storedSettings.value(
+        "pixel_deadband", DEFAULT_PIXEL_DEADBAND).toDouble();
+    m_panelLayout = m_storedSettings.value(
+        "panel_layout", DEFAULT_PANEL_LAYOUT).toString();
 }
 
 
@@ -145,33 +277,159 @@ SettingsDialog::setCurrentPort(const QString &portName, QComboBox *comboBox)
 }
 
 
-MainWindow::MainWindow(QWidget *parent) :
+LatencyDialog::LatencyDialog(QWidget *parent) :
+    QDialog(parent)
+{
+    setWindowTitle(tr("Latency"));
+    
+    m_enabledCheckBox = new QCheckBox("Trace latency");
+    m_enabledCheckBox->setChecked(LatencyTrace::enabled());
+    connect(m_enabledCheckBox, SIGNAL(toggled(bool)),
+            this, SLOT(setTracing(bool)));
+    
+    m_table = new QTableWidget(LatencyStageCount, 4);
+    m_table->setHorizontalHeaderLabels(QStringList() << "Frames"
+                                       << "p50 (\u00B5s)" << "p99 (\u00B5s)"
+                                       << "Max (\u00B5s)");
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    QStringList stageNames;
+    for (int i = 0; i < LatencyStageCount; i++) {
+        stageNames.append(LatencyTrace::stageName(LatencyStage(i)));
+        for (int column = 0; column < m_table->columnCount(); column++)
+            m_table->setItem(i, column, new QTableWidgetItem);
+    }
+    m_table->setVerticalHeaderLabels(stageNames);
+    
+    auto resetButton = new QPushButton("Reset");
+    auto saveButton = new QPushButton("Save...");
+    connect(resetButton, SIGNAL(clicked()), this, SLOT(resetHistograms()));
+    connect(saveButton, SIGNAL(clicked()), this, SLOT(saveReport()));
+    
+    auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    buttonBox->addButton(resetButton, QDialogButtonBox::ResetRole);
+    buttonBox->addButton(saveButton, QDialogButtonBox::ActionRole);
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+    
+    auto layout = new QVBoxLayout;
+    layout->addWidget(m_enabledCheckBox);
+    layout->addWidget(m_table);
+    layout->addWidget(buttonBox);
+    setLayout(layout);
+    
+    m_refreshTimer.setInterval(500);
+    connect(&m_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+
+void
+LatencyDialog::refresh()
+{
+    for (int i = 0; i < LatencyStageCount; i++) {
+        const LatencyHistogram &histogram =
+            LatencyTrace::histogram(LatencyStage(i));
+        m_table->item(i, 0)->setText(QString::number(histogram.count()));
+        m_table->item(i, 1)->setText(
+            QString::number(histogram.percentile(0.5) / 1e3, 'f', 1));
+        m_table->item(i, 2)->setText(
+            QString::number(histogram.percentile(0.99) / 1e3, 'f', 1));
+        m_table->item(i, 3)->setText(
+            QString::number(histogram.maximum() / 1e3, 'f', 1));
+    }
+}
+
+
+void
+LatencyDialog::resetHistograms()
+{
+    LatencyTrace::reset();
+    refresh();
+}
+
+
+void
+LatencyDialog::saveReport()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Save latency report",
+                                                    QString(),
+                                                    "Text files (*.txt)");
+    if (!fileName.isEmpty() && !LatencyTrace::dump(fileName))
+        qWarning() << "Could not write latency report" << fileName;
+}
+
+
+void
+LatencyDialog::setTracing(bool enabled)
+{
+    LatencyTrace::setEnabled(enabled);
+}
+
+
+void
+LatencyDialog::showEvent(QShowEvent *event)
+{
+    m_enabledCheckBox->setChecked(LatencyTrace::enabled());
+    refresh();
+    m_refreshTimer.start();
+    QDialog::showEvent(event);
+}
+
+
+void
+LatencyDialog::hideEvent(QHideEvent *event)
+{
+    m_refreshTimer.stop();
+    QDialog::hideEvent(event);
+}
+
+
+MainWindow::MainWindow(QWidget *parent, const ReplaySettings &replay) :
     QMainWindow(parent)
 {
-    m_efisStream = new EfisStream(m_settings.efisPort(), this);
-    m_emsStream = new EmsStream(m_settings.emsPort(), this);
+    LatencyTrace::setEnabled(m_settings.traceLatency());
+    
+    if (replay.efisLog.isEmpty()) {
+        m_efisStream = new EfisStream(m_settings.efisPort(), this);
+        m_efisStream->startReaderThread();
+        connect(&m_settings, SIGNAL(efisPortChanged(const QString &)),
+                m_efisStream, SLOT(setPort(const QString &)));
+    } else {
+        m_efisStream = new ReplayStream(replay.efisLog, replay.speed, this);
+        QTimer::singleShot(0, m_efisStream, SLOT(start()));
+    }
+    
+    if (replay.emsLog.isEmpty()) {
+        m_emsStream = new EmsStream(m_settings.emsPort(), this);
+        m_emsStream->startReaderThread();
+        connect(&m_settings, SIGNAL(emsPortChanged(const QString &)),
+                m_emsStream, SLOT(setPort(const QString &)));
+    } else {
+        m_emsStream = new ReplayStream(replay.emsLog, replay.speed, this);
+        QTimer::singleShot(0, m_emsStream, SLOT(start()));
+    }
 
+    m_efisStream->setLogPolicy(m_settings.logPolicy());
+    m_emsStream->setLogPolicy(m_settings.logPolicy());
     updateLogFolder(m_settings.logFolder());
     connect(&m_settings, SIGNAL(logFolderChanged(const QString &)), 
             this, SLOT(updateLogFolder(const QString &)));
 
-    connect(&m_settings, SIGNAL(efisPortChanged(const QString &)),
-            m_efisStream, SLOT(setPort(const QString &)));
-    connect(&m_settings, SIGNAL(emsPortChanged(const QString &)),
-            m_emsStream, SLOT(setPort(const QString &)));
-    connect(m_efisStream, SIGNAL(variableUpdated(const TelemetryVariable &)),
-            &m_updater, SLOT(update(const TelemetryVariable &)));
-    connect(m_emsStream, SIGNAL(variableUpdated(const TelemetryVariable &)),
-            &m_updater, SLOT(update(const TelemetryVariable &)));
+    m_updater.setDisplayRate(m_settings.displayRate());
+    m_updater.attach(m_efisStream);
+    m_updater.attach(m_emsStream);
     
     auto showSettings = new QAction("Settings", this);
     showSettings->setIcon(QIcon(":/images/settings.ico"));
     connect(showSettings, SIGNAL(triggered()), 
             this, SLOT(showSettingsDialog()));
     
+    auto showLatency = new QAction("Latency", this);
+    connect(showLatency, SIGNAL(triggered()),
+            this, SLOT(showLatencyDialog()));
+    
     auto mainToolBar = addToolBar("Main");
     mainToolBar->setMovable(false);
     mainToolBar->addAction(showSettings);
+    mainToolBar->addAction(showLatency);
 
     m_efisStatusLabel = new QLabel("EFIS offline.");
     m_emsStatusLabel = new QLabel("EMS offline.");
@@ -181,9 +439,9 @@ MainWindow::MainWindow(QWidget *parent) :
     m_efisStatusTimer = new QTimer(this);
     m_efisStatusTimer->setInterval(1000);
     m_efisStatusTimer->setSingleShot(true);
-    connect(m_efisStream, SIGNAL(messageReceived(const TelemetryMessage &)),
+    connect(m_efisStream, SIGNAL(frameReceived(const TelemetryFrame &)),
             m_efisStatusTimer, SLOT(start()));
-    connect(m_efisStream, SIGNAL(messageReceived(const TelemetryMessage &)),
+    connect(m_efisStream, SIGNAL(frameReceived(const TelemetryFrame &)),
             this, SLOT(efisOnline()));
     connect(m_efisStatusTimer, SIGNAL(timeout()),
             this, SLOT(efisOffline()));
@@ -191,305 +449,117 @@ MainWindow::MainWindow(QWidget *parent) :
     m_emsStatusTimer = new QTimer(this);
     m_emsStatusTimer->setInterval(1000);
     m_emsStatusTimer->setSingleShot(true);
-    connect(m_emsStream, SIGNAL(messageReceived(const TelemetryMessage &)),
+    connect(m_emsStream, SIGNAL(frameReceived(const TelemetryFrame &)),
             m_emsStatusTimer, SLOT(start()));
-    connect(m_emsStream, SIGNAL(messageReceived(const TelemetryMessage &)),
+    connect(m_emsStream, SIGNAL(frameReceived(const TelemetryFrame &)),
             this, SLOT(emsOnline()));
     connect(m_emsStatusTimer, SIGNAL(timeout()),
             this, SLOT(emsOffline()));
     
-    auto rpmGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    rpmGauge->setValueRange(0, 3500);
-    rpmGauge->setAngleRange(-135, 90);
-    rpmGauge->setNumMajorTicks(8);
-    rpmGauge->setTextColor(QColor("white"));
-    rpmGauge->addRangeBand(QColor("darkgreen"), 600, 2700);
-    rpmGauge->addRangeBand(QColor("goldenrod"), 2700, 3200);
-    rpmGauge->addRangeBand(QColor("darkred"), 3200, 3500);
-    rpmGauge->setBottomLabel("RPM");
-    m_updater.link("RPM", [=](double value){rpmGauge->setValue(value);});
-    
-    auto cht1Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    cht1Gauge->setValueRange(150, 500);
-    cht1Gauge->setNumMajorTicks(8);
-    cht1Gauge->setTextColor(QColor("white"));
-    cht1Gauge->addRangeBand(QColor("darkred"), 0, 150);
-    cht1Gauge->addRangeBand(QColor("goldenrod"), 150, 200);
-    cht1Gauge->addRangeBand(QColor("darkgreen"), 200, 435);
-    cht1Gauge->addRangeBand(QColor("goldenrod"), 435, 450);
-    cht1Gauge->addRangeBand(QColor("darkred"), 450, 500);
-    m_updater.link("cht1", [=](double value){cht1Gauge->setValue(value);});
-
-    auto cht2Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    cht2Gauge->setValueRange(150, 500);
-    cht2Gauge->setNumMajorTicks(8);
-    cht2Gauge->setTextColor(QColor("white"));
-    cht2Gauge->addRangeBand(QColor("darkred"), 0, 150);
-    cht2Gauge->addRangeBand(QColor("goldenrod"), 150, 200);
-    cht2Gauge->addRangeBand(QColor("darkgreen"), 200, 435);
-    cht2Gauge->addRangeBand(QColor("goldenrod"), 435, 450);
-    cht2Gauge->addRangeBand(QColor("darkred"), 450, 500);
-    m_updater.link("cht2", [=](double value){cht2Gauge->setValue(value);});
-
-    auto cht3Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    cht3Gauge->setValueRange(150, 500);
-    cht3Gauge->setNumMajorTicks(8);
-    cht3Gauge->setTextColor(QColor("white"));
-    cht3Gauge->addRangeBand(QColor("darkred"), 0, 150);
-    cht3Gauge->addRangeBand(QColor("goldenrod"), 150, 200);
-    cht3Gauge->addRangeBand(QColor("darkgreen"), 200, 435);
-    cht3Gauge->addRangeBand(QColor("goldenrod"), 435, 450);
-    cht3Gauge->addRangeBand(QColor("darkred"), 450, 500);
-    m_updater.link("cht3", [=](double value){cht3Gauge->setValue(value);});
-
-    auto cht4Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    cht4Gauge->setValueRange(150, 500);
-    cht4Gauge->setNumMajorTicks(8);
-    cht4Gauge->setTextColor(QColor("white"));
-    cht4Gauge->addRangeBand(QColor("darkred"), 0, 150);
-    cht4Gauge->addRangeBand(QColor("goldenrod"), 150, 200);
-    cht4Gauge->addRangeBand(QColor("darkgreen"), 200, 435);
-    cht4Gauge->addRangeBand(QColor("goldenrod"), 435, 450);
-    cht4Gauge->addRangeBand(QColor("darkred"), 450, 500);
-    m_updater.link("cht4", [=](double value){cht4Gauge->setValue(value);});
-    
-    auto chtLayout = new QVBoxLayout;
-    chtLayout->setSpacing(0);
-    chtLayout->addWidget(cht1Gauge);
-    chtLayout->addWidget(cht2Gauge);
-    chtLayout->addWidget(cht3Gauge);
-    chtLayout->addWidget(cht4Gauge);
-    
-    auto chtGroupBox = new QGroupBox("CHT");
-    chtGroupBox->setAlignment(Qt::AlignHCenter);
-    chtGroupBox->setLayout(chtLayout);
-
-    auto oilPressGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    oilPressGauge->setValueRange(0, 100);
-    oilPressGauge->setAngleRange(-135, 90);
-    oilPressGauge->setNumMajorTicks(11);
-    oilPressGauge->addRangeBand(QColor("darkred"), 0, 15);
-    oilPressGauge->addRangeBand(QColor("goldenrod"), 15, 20);
-    oilPressGauge->addRangeBand(QColor("darkgreen"), 20, 90);
-    oilPressGauge->addRangeBand(QColor("goldenrod"), 90, 95);
-    oilPressGauge->addRangeBand(QColor("darkred"), 95, 100);
-    oilPressGauge->setTextColor(QColor("white"));
-    oilPressGauge->setBottomLabel("Oil press.");
-    oilPressGauge->setTopLabel("psi");
-    m_updater.link("oil pressure",
-                   [=](double value){oilPressGauge->setValue(value);});
- 
-    auto mapGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    mapGauge->setValueRange(0, 40);
-    mapGauge->setAngleRange(-135, 90);
-    mapGauge->setNumMajorTicks(6);
-    mapGauge->setNumMinorTicks(3);
-    mapGauge->addRangeBand(QColor("darkgreen"), 0, 36);
-    mapGauge->addRangeBand(QColor("goldenrod"), 36, 38);
-    mapGauge->addRangeBand(QColor("darkred"), 38, 40);
-    mapGauge->setTextColor(QColor("white"));
-    mapGauge->setBottomLabel("MAP");
-    mapGauge->setTopLabel("inHg");
-    m_updater.link("manifold pressure",
-                   [=](double value){mapGauge->setValue(value);});
-    
-    auto egt1Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    egt1Gauge->setValueRange(800, 1600);
-    egt1Gauge->setNumMajorTicks(5);
-    egt1Gauge->setNumMinorTicks(3);
-    egt1Gauge->setTextColor(QColor("white"));
-    egt1Gauge->addRangeBand(QColor("darkgreen"), 400, 1500);
-    egt1Gauge->addRangeBand(QColor("goldenrod"), 1500, 1600);
-    egt1Gauge->setValue(1600);
-    m_updater.link("egt1", [=](double value){egt1Gauge->setValue(value);});
-
-    auto egt2Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    egt2Gauge->setValueRange(800, 1600);
-    egt2Gauge->setNumMajorTicks(5);
-    egt2Gauge->setNumMinorTicks(3);
-    egt2Gauge->setTextColor(QColor("white"));
-    egt2Gauge->addRangeBand(QColor("darkgreen"), 400, 1500);
-    egt2Gauge->addRangeBand(QColor("goldenrod"), 1500, 1600);
-    m_updater.link("egt2", [=](double value){egt2Gauge->setValue(value);});
-
-    auto egt3Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    egt3Gauge->setValueRange(800, 1600);
-    egt3Gauge->setNumMajorTicks(5);
-    egt3Gauge->setNumMinorTicks(3);
-    egt3Gauge->setTextColor(QColor("white"));
-    egt3Gauge->addRangeBand(QColor("darkgreen"), 400, 1500);
-    egt3Gauge->addRangeBand(QColor("goldenrod"), 1500, 1600);
-    m_updater.link("egt3", [=](double value){egt3Gauge->setValue(value);});
-
-    auto egt4Gauge = new LinearSvgGauge(":/images/horizontal-gauge.svg");
-    egt4Gauge->setValueRange(800, 1600);
-    egt4Gauge->setNumMajorTicks(5);
-    egt4Gauge->setNumMinorTicks(3);
-    egt4Gauge->setTextColor(QColor("white"));
-    egt4Gauge->addRangeBand(QColor("darkgreen"), 400, 1500);
-    egt4Gauge->addRangeBand(QColor("goldenrod"), 1500, 1600);
-    m_updater.link("egt4", [=](double value){egt4Gauge->setValue(value);});
-    
-    auto egtLayout = new QVBoxLayout;
-    egtLayout->setSpacing(0);
-    egtLayout->addWidget(egt1Gauge);
-    egtLayout->addWidget(egt2Gauge);
-    egtLayout->addWidget(egt3Gauge);
-    egtLayout->addWidget(egt4Gauge);
-    
-    auto egtGroupBox = new QGroupBox("EGT");
-    egtGroupBox->setAlignment(Qt::AlignHCenter);
-    egtGroupBox->setLayout(egtLayout);
-
-    auto oilTempGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    oilTempGauge->setValueRange(60, 260);
-    oilTempGauge->setAngleRange(-135, 90);
-    oilTempGauge->setNumMajorTicks(11);
-    oilTempGauge->addRangeBand(QColor("goldenrod"), 60, 100);
-    oilTempGauge->addRangeBand(QColor("darkgreen"), 100, 220);
-    oilTempGauge->addRangeBand(QColor("goldenrod"), 220, 240);
-    oilTempGauge->addRangeBand(QColor("darkred"), 240, 260);
-    oilTempGauge->setTextColor(QColor("white"));
-    oilTempGauge->setBottomLabel("Oil temp.");
-    oilTempGauge->setTopLabel("\u00B0F");
-    m_updater.link("oil temperature",
-                   [=](double value){oilTempGauge->setValue(value);});
+    setWindowTitle(tr("Telemetry"));
     
-    auto fuelPressGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    fuelPressGauge->setValueRange(0, 30);
-    fuelPressGauge->setAngleRange(-135, 90);
-    fuelPressGauge->setNumMajorTicks(7);
-    fuelPressGauge->addRangeBand(QColor("darkred"), 0, 10);
-    fuelPressGauge->addRangeBand(QColor("goldenrod"), 10, 15);
-    fuelPressGauge->addRangeBand(QColor("darkgreen"), 15, 27);
-    fuelPressGauge->addRangeBand(QColor("goldenrod"), 27, 28);
-    fuelPressGauge->addRangeBand(QColor("darkred"), 28, 30);
-    fuelPressGauge->setTextColor(QColor("white"));
-    fuelPressGauge->setBottomLabel("Fuel pressure");
-    fuelPressGauge->setTopLabel("psi");
-    m_updater.link("fuel pressure",
-                   [=](double value){fuelPressGauge->setValue(value);});
-
-    auto fuelLevel1Gauge = new AngularSvgGauge(":/images/top-circle-gauge.svg");
-    fuelLevel1Gauge->setValueRange(0, 24);
-    fuelLevel1Gauge->setAngleRange(-80, 80);
-    fuelLevel1Gauge->setNumMajorTicks(7);
-    fuelLevel1Gauge->addRangeBand(QColor("darkred"), 0, 1.3);
-    fuelLevel1Gauge->addRangeBand(QColor("goldenrod"), 1.3, 1.5);
-    fuelLevel1Gauge->addRangeBand(QColor("darkgreen"), 1.5, 24);
-    fuelLevel1Gauge->setTextColor(QColor("white"));
-    fuelLevel1Gauge->setTopLabel("Fuel 1 (gal)");
-    //fuelLevel1Gauge->setTopLabel("gal");
-    m_updater.link("fuel level 1",
-                   [=](double value){fuelLevel1Gauge->setValue(value);});
-
-
-    auto fuelLevel2Gauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    fuelLevel2Gauge->setValueRange(0, 4);
-    fuelLevel2Gauge->setAngleRange(-135, 90);
-    fuelLevel2Gauge->setNumMajorTicks(6);
-    fuelLevel2Gauge->addRangeBand(QColor("darkred"), 0, 1.3);
-    fuelLevel2Gauge->addRangeBand(QColor("goldenrod"), 1.3, 1.5);
-    fuelLevel2Gauge->addRangeBand(QColor("darkgreen"), 1.5, 4);
-    fuelLevel2Gauge->setTextColor(QColor("white"));
-    fuelLevel2Gauge->setBottomLabel("Fuel level 2");
-    fuelLevel2Gauge->setTopLabel("gal");
-    m_updater.link("fuel level 2",
-                   [=](double value){fuelLevel2Gauge->setValue(value);});
-
-    auto fuelFlowGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    fuelFlowGauge->setValueRange(0, 25);
-    fuelFlowGauge->setAngleRange(-135, 90);
-    fuelFlowGauge->setNumMajorTicks(6);
-    fuelFlowGauge->addRangeBand(QColor("darkgreen"), 0, 22);
-    fuelFlowGauge->addRangeBand(QColor("goldenrod"), 22, 25);
-    fuelFlowGauge->setTextColor(QColor("white"));
-    fuelFlowGauge->setBottomLabel("Fuel flow");
-    fuelFlowGauge->setTopLabel("gal/h");
-    m_updater.link("fuel flow",
-                   [=](double value){fuelFlowGauge->setValue(value);});
-
-    auto lambdaGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    lambdaGauge->setValueRange(0, 100);
-    lambdaGauge->setAngleRange(-135, 90);
-    lambdaGauge->setNumMajorTicks(11);
-    lambdaGauge->addRangeBand(QColor("darkgreen"), 30, 35);
-    lambdaGauge->setTextColor(QColor("white"));
-    lambdaGauge->setBottomLabel("Lambda");
-    lambdaGauge->setTopLabel("%");
-    m_updater.link("aileron trim",
-                   [=](double value){lambdaGauge->setValue(value);});
+    PanelLayout panel;
+    if (!panel.load(m_settings.panelLayout()))
+        panel.load(DEFAULT_PANEL_LAYOUT);
+    m_pages = panel.pages();
+    m_pageBuilt.fill(false, m_pages.size());
     
-    auto altitudeGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    altitudeGauge->setValueRange(0, 10000);
-    altitudeGauge->setAngleRange(-135, 90);
-    altitudeGauge->setNumMajorTicks(11);
-    altitudeGauge->setTextColor(QColor("white"));
-    altitudeGauge->setBottomLabel("Altitude");
-    altitudeGauge->setTopLabel("ft");
-    m_updater.link("displayed altitude",
-                   [=](double value){altitudeGauge->setValue(value*3.28084);});
-
-    auto airspeedGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    airspeedGauge->setValueRange(0, 400);
-    airspeedGauge->setAngleRange(-135, 90);
-    airspeedGauge->setNumMajorTicks(9);
-    airspeedGauge->addRangeBand(QColor("darkgreen"), 70, 180);
-    airspeedGauge->addRangeBand(QColor("goldenrod"), 180, 310);
-    airspeedGauge->addRangeBand(QColor("darkred"), 310, 350);
-    airspeedGauge->setTextColor(QColor("white"));
-    airspeedGauge->setBottomLabel("Airspeed");
-    airspeedGauge->setTopLabel("kt");
-    m_updater.link("airspeed",
-                   [=](double value){airspeedGauge->setValue(value*1.9438);});
-
-
-    auto climbRateGauge = new AngularSvgGauge(":/images/angular-gauge.svg");
-    climbRateGauge->setValueRange(-4000, 4000);
-    climbRateGauge->setAngleRange(-135, 135);
-    climbRateGauge->setNumMajorTicks(9);
-    climbRateGauge->setTextColor(QColor("white"));
-    climbRateGauge->setBottomLabel("Climb Rate");
-    climbRateGauge->setTopLabel("fpm");
-    m_updater.link("vertical speed",
-                   [=](double value){climbRateGauge->setValue(value*60);});
-
-    auto column1Layout = new QVBoxLayout;
-    column1Layout->addWidget(chtGroupBox);
-    column1Layout->addWidget(egtGroupBox);
-
-    auto column2Layout = new QVBoxLayout;
-    column2Layout->addWidget(mapGauge);
-    column2Layout->addWidget(oilTempGauge);
-    column2Layout->addWidget(fuelLevel1Gauge);
-
-    auto column3Layout = new QVBoxLayout;
-    column3Layout->addWidget(rpmGauge);
-    column3Layout->addWidget(oilPressGauge);
-    column3Layout->addWidget(fuelLevel2Gauge);
-
-    auto column4Layout = new QVBoxLayout;
-    column4Layout->addWidget(fuelPressGauge);
-    column4Layout->addWidget(fuelFlowGauge);
-    column4Layout->addWidget(lambdaGauge);
-
-    auto column5Layout = new QVBoxLayout;
-    column5Layout->addWidget(altitudeGauge);
-    column5Layout->addWidget(airspeedGauge);
-    column5Layout->addWidget(climbRateGauge);
+    //Only placeholders for now, each page is built the first time it shows
+    m_pageTabs = new QTabWidget;
+    m_pageTabs->setDocumentMode(true);
+    m_pageTabs->setTabBarAutoHide(true);
+    for (const auto &page: m_pages)
+        m_pageTabs->addTab(new QWidget, page.title);
+    connect(m_pageTabs, SIGNAL(currentChanged(int)),
+            this, SLOT(buildPage(int)));
+    buildPage(m_pageTabs->currentIndex());
+    setCentralWidget(m_pageTabs);
+}
+
+
+MainWindow::~MainWindow()
+{
+    m_efisStream->stopLogging();
+    m_emsStream->stopLogging();
+    m_efisStream->stopCapture();
+    m_emsStream->stopCapture();
+    for (auto stream: {m_efisStream, m_emsStream}) {
+        if (stream->droppedLogRecords() || stream->droppedCaptureChunks())
+            qWarning() << "Dropped" << stream->droppedLogRecords()
+                       << "log records and" << stream->droppedCaptureChunks()
+                       << "capture chunks";
+    }
+    delete m_logSession;
+    LogSession::waitForFinishedSegments();
+}
 
+
+void
+MainWindow::buildPage(int index)
+{
+    if (index < 0 || m_pageBuilt[index])
+        return;
+    m_pageBuilt[index] = true;
+    
+    const PageLayout &page = m_pages[index];
+    QWidget *pageWidget = m_pageTabs->widget(index);
+    Dashboard *dashboard = 0;
     auto mainLayout = new QHBoxLayout;
-    mainLayout->addItem(column1Layout);
-    mainLayout->addItem(column2Layout);
-    mainLayout->addItem(column3Layout);
-    mainLayout->addItem(column4Layout);
-    mainLayout->addItem(column5Layout);
+    if (m_settings.dashboardMode()) {
+        //Columns 100 units wide, titles take 10 units and gauges share the rest
+        dashboard = new Dashboard(QSizeF(100 * page.columns.size(), 300));
+        mainLayout->setContentsMargins(0, 0, 0, 0);
+        mainLayout->addWidget(dashboard);
+    }
     
-    QWidget *centralWidget = new QWidget;
-    centralWidget->setLayout(mainLayout);
-    setCentralWidget(centralWidget);
+    for (int column = 0; column < page.columns.size(); column++) {
+        int numTitles = 0, numGauges = 0;
+        for (const auto &group: page.columns[column]) {
+            numTitles += !group.title.isEmpty();
+            numGauges += group.gauges.size();
+        }
+        double gaugeHeight = (300.0 - 10 * numTitles) / qMax(numGauges, 1);
+        double y = 0;
+        
+        QVBoxLayout *columnLayout = dashboard ? 0 : new QVBoxLayout;
+        for (const auto &group: page.columns[column]) {
+            QVBoxLayout *groupLayout = columnLayout;
+            if (!group.title.isEmpty() && dashboard) {
+                dashboard->addTitle(group.title,
+                                    QRectF(100 * column, y, 100, 10));
+                y += 10;
+            } else if (!group.title.isEmpty()) {
+                groupLayout = new QVBoxLayout;
+                groupLayout->setSpacing(0);
+                auto groupBox = new QGroupBox(group.title);
+                groupBox->setAlignment(Qt::AlignHCenter);
+                groupBox->setLayout(groupLayout);
+                columnLayout->addWidget(groupBox);
+            }
+            
+            for (const auto &gaugeLayout: group.gauges) {
+                TickedSvgGauge *gauge = gaugeLayout.create();
+                gauge->setPixelDeadband(m_settings.pixelDeadband());
+                double scale = gaugeLayout.scale;
+                m_updater.link(gaugeLayout.variable, [=](double value) {
+                    gauge->setValue(value * scale);
+                });
+                
+                if (dashboard) {
+                    dashboard->addGauge(gauge, QRectF(100 * column, y,
+                                                      100, gaugeHeight));
+                    y += gaugeHeight;
+                } else {
+                    groupLayout->addWidget(gauge);
+                }
+            }
+        }
+        
+        if (columnLayout)
+            mainLayout->addItem(columnLayout);
+    }
     
-    setWindowTitle(tr("Telemetry"));
+    pageWidget->setLayout(mainLayout);
 }
 
 
@@ -528,12 +598,39 @@ MainWindow::showSettingsDialog()
     settingsDialog.exec();
 }
 
+
+void
+MainWindow::showLatencyDialog()
+{
+    //Modeless, so the histograms keep updating along with the gauges
+    if (!m_latencyDialog)
+        m_latencyDialog = new LatencyDialog(this);
+    
+    m_latencyDialog->show();
+    m_latencyDialog->raise();
+    m_latencyDialog->activateWindow();
+}
+
 void
 MainWindow::updateLogFolder(const QString &logFolder)
 {
-    auto now = QDateTime::currentDateTime();
-    QString dateStr = now.toString("yyyy-MM-dd_HH'h'mm'm'");
+    auto format = TelemetryStream::TextLog;
+    if (m_settings.binaryLog())
+        format = TelemetryStream::BinaryLog;
     
-    m_efisStream->startLogging(logFolder + "/efis_" + dateStr + ".log");
-    m_emsStream->startLogging(logFolder + "/ems_" + dateStr + ".log");
+    //Both streams let go of the previous session before it is deleted
+    LogSession *previous = m_logSession;
+    m_logSession = new LogSession(logFolder, m_settings.rotationPolicy());
+    QPair<TelemetryStream *, QString> streams[] = {{m_efisStream, "efis"},
+                                                   {m_emsStream, "ems"}};
+    for (const auto &stream: streams) {
+        //Replayed logs are not written back into the log folder
+        if (qobject_cast<ReplayStream *>(stream.first))
+            continue;
+        
+        stream.first->startLogging(m_logSession, stream.second, format);
+        if (m_settings.captureRaw())
+            stream.first->startCapture(m_logSession, stream.second);
+    }
+    delete previous;
 }
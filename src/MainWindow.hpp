@@ -2,18 +2,28 @@
 #define MAINWINDOW_HPP
 
 #include "Gauge.hpp"
+#include "PanelLayout.hpp"
+#include "ReplayStream.hpp"
 #include "TelemetryStream.hpp"
 
 
 #include <QPushButton>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDialog>
 #include <QLabel>
 #include <QMainWindow>
-#include <QMap>
+#include <QPair>
 #include <QSettings>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVarLengthArray>
+#include <QVector>
 
-#include <functional>
+#include <cstddef>
+#include <new>
+#include <type_traits>
 
 
 /* TODO:
@@ -22,19 +32,76 @@
  */
 
 
+/* Callable taking the new value of a variable, stored inline: the lambdas
+ * linking gauges only capture the gauge and its scale factor, so no heap
+ * allocation. The storage fits a pointer and a double on any target.
+ */
+class InlineUpdater
+{
+public:
+    InlineUpdater() {}
+    
+    template <typename F>
+    InlineUpdater(F f)
+    {
+        static_assert(sizeof(F) <= sizeof(m_storage),
+                      "updater captures too much to be stored inline");
+        static_assert(alignof(F) <= alignof(std::max_align_t),
+                      "updater captures are too strictly aligned");
+        static_assert(std::is_trivially_copyable<F>::value,
+                      "updater captures must be trivially copyable");
+        new (m_storage) F(f);
+        m_call = [](const void *storage, double value) {
+            (*static_cast<const F*>(storage))(value);
+        };
+    }
+    
+    void operator()(double value) const {m_call(m_storage, value);}
+
+private:
+    alignas(std::max_align_t) char m_storage[16];
+    void (*m_call)(const void *storage, double value) = 0;
+};
+
+
+/* Incoming values are only stored as pending, the gauges get the latest
+ * value of each variable once per display tick and only if it changed.
+ */
 class GaugeUpdater : public QObject
 {
     Q_OBJECT
     
 public slots:
-    void update(const TelemetryVariable &var);
+    void update(const TelemetryFrame &frame);
+    void applyPending();
 
 public:
-    typedef std::function<void(double)> updater;
+    typedef InlineUpdater updater;
+    explicit GaugeUpdater(QObject *parent=0);
+    void attach(TelemetryStream *stream);
     void link(const QString &label, updater updater);
+    void setDisplayRate(int hertz);
     
 private:
-    QMap<QString, updater> m_updaters;
+    typedef QVarLengthArray<updater, 2> UpdaterList;
+    
+    //Updaters of one stream's variables, indexed by variable id
+    struct DispatchTable
+    {
+        const VariableTable *variables;
+        QVector<UpdaterList> updaters;
+        quint64 linked, pending;
+        double pendingValues[MAX_FRAME_VARIABLES];
+        double appliedValues[MAX_FRAME_VARIABLES];
+        double latestValues[MAX_FRAME_VARIABLES];
+        qint64 pendingArrivals[MAX_FRAME_VARIABLES];
+    };
+    
+    QVector<QPair<QString, updater>> m_links;
+    QVector<DispatchTable> m_tables;
+    QTimer m_displayTimer;
+    
+    int resolve(DispatchTable &table, const QString &label, updater updater);
 };
 
 
@@ -53,6 +120,15 @@ public:
     QString emsPort() const {return m_emsPort;}
     QString efisPort() const {return m_efisPort;}
     QString logFolder() const {return m_logFolder;}
+    int displayRate() const {return m_displayRate;}
+    bool binaryLog() const {return m_binaryLog;}
+    LogPolicy logPolicy() const {return m_logPolicy;}
+    RotationPolicy rotationPolicy() const {return m_rotationPolicy;}
+    bool captureRaw() const {return m_captureRaw;}
+    bool traceLatency() const {return m_traceLatency;}
+    bool dashboardMode() const {return m_dashboardMode;}
+    double pixelDeadband() const {return m_pixelDeadband;}
+    QString panelLayout() const {return m_panelLayout;}
     void setEmsPort(const QString &newEmsPort);
     void setEfisPort(const QString &newEmsPort);
     void setLogFolder(const QString &newLogFolder);
@@ -68,6 +144,15 @@ public slots:
 private:
     QSettings m_storedSettings;
     QString m_emsPort, m_efisPort, m_logFolder;
+    int m_displayRate;
+    bool m_binaryLog;
+    LogPolicy m_logPolicy;
+    RotationPolicy m_rotationPolicy;
+    bool m_captureRaw;
+    bool m_traceLatency;
+    bool m_dashboardMode;
+    double m_pixelDeadband;
+    QString m_panelLayout;
 };
 
 
@@ -91,28 +176,69 @@ protected:
 };
 
 
+//Per-stage latency histograms of LatencyTrace, refreshed while shown
+class LatencyDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    LatencyDialog(QWidget *parent=0);
+
+public slots:
+    void refresh();
+    void resetHistograms();
+    void saveReport();
+    void setTracing(bool enabled);
+
+protected:
+    QCheckBox *m_enabledCheckBox;
+    QTableWidget *m_table;
+    QTimer m_refreshTimer;
+    
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+};
+
+
+//Logs to play back instead of reading the serial ports
+struct ReplaySettings
+{
+    QString efisLog, emsLog;
+    double speed = 1;
+};
+
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
     
 public:
-    explicit MainWindow(QWidget *parent = 0);
+    explicit MainWindow(QWidget *parent = 0,
+                        const ReplaySettings &replay = ReplaySettings());
+    ~MainWindow();
 
 public slots:
+    void buildPage(int index);
     void efisOnline();
     void efisOffline();
     void emsOnline();
     void emsOffline();
     void showSettingsDialog();
+    void showLatencyDialog();
     void updateLogFolder(const QString &logFolder);
 
 private:
     Settings m_settings;
     GaugeUpdater m_updater;
-    EfisStream *m_efisStream;
-    EmsStream *m_emsStream;
+    TelemetryStream *m_efisStream;
+    TelemetryStream *m_emsStream;
+    LogSession *m_logSession = 0;
+    LatencyDialog *m_latencyDialog = 0;
     QLabel *m_efisStatusLabel, *m_emsStatusLabel;
     QTimer *m_efisStatusTimer, *m_emsStatusTimer;
+    QTabWidget *m_pageTabs;
+    QVector<PageLayout> m_pages;
+    QVector<bool> m_pageBuilt;
 };
 
 #endif // MAINWINDOW_HPP
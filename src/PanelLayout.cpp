@@ -0,0 +1,150 @@
+#include "PanelLayout.hpp"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+
+#define MAX_LAYOUT_TICKS 100 //Major ticks, or minor ticks between two majors
+
+
+static bool parseGauge(const QJsonObject &object, const QJsonObject &defaults,
+                       GaugeLayout &gauge);
+
+
+TickedSvgGauge *
+GaugeLayout::create() const
+{
+    TickedSvgGauge *gauge;
+    if (angular)
+        gauge = new AngularSvgGauge(svgFile);
+    else
+        gauge = new LinearSvgGauge(svgFile);
+    
+    gauge->configure(spec);
+    if (!std::isnan(initialValue))
+        gauge->setValue(initialValue);
+    
+    return gauge;
+}
+
+
+bool
+PanelLayout::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open panel layout" << fileName;
+        return false;
+    }
+    
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        qWarning() << "Invalid panel layout" << fileName
+                   << error.errorString();
+        return false;
+    }
+    
+    QJsonObject root = document.object();
+    QJsonObject defaults = root.value("defaults").toObject();
+    QVector<PageLayout> pages;
+    for (const auto &pageValue: root.value("pages").toArray()) {
+        QJsonObject pageObject = pageValue.toObject();
+        PageLayout page;
+        page.title = pageObject.value("title").toString();
+        
+        for (const auto &columnValue: pageObject.value("columns").toArray()) {
+            QVector<GaugeGroupLayout> column;
+            for (const auto &entryValue: columnValue.toArray()) {
+                //A gauge on its own is an untitled group of one
+                QJsonObject entry = entryValue.toObject();
+                QJsonArray gauges;
+                GaugeGroupLayout group;
+                if (entry.contains("group")) {
+                    group.title = entry.value("group").toString();
+                    gauges = entry.value("gauges").toArray();
+                } else {
+                    gauges.append(entry);
+                }
+                
+                for (const auto &gaugeValue: gauges) {
+                    GaugeLayout gauge;
+                    if (!parseGauge(gaugeValue.toObject(), defaults, gauge)) {
+                        qWarning() << "Invalid gauge in panel layout"
+                                   << fileName;
+                        return false;
+                    }
+                    group.gauges.append(gauge);
+                }
+                column.append(group);
+            }
+            page.columns.append(column);
+        }
+        pages.append(page);
+    }
+    
+    if (pages.isEmpty()) {
+        qWarning() << "No pages in panel layout" << fileName;
+        return false;
+    }
+    
+    m_pages = pages;
+    return true;
+}
+
+
+static bool
+parseGauge(const QJsonObject &object, const QJsonObject &defaults,
+           GaugeLayout &gauge)
+{
+    QString type = object.value("type").toString();
+    if (type != "angular" && type != "linear")
+        return false;
+    
+    QJsonObject merged = defaults.value(type).toObject();
+    for (auto key: object.keys())
+        merged.insert(key, object.value(key));
+    
+    gauge.angular = type == "angular";
+    gauge.svgFile = merged.value("svg").toString();
+    gauge.variable = merged.value("variable").toString();
+    gauge.scale = merged.value("scale").toDouble(1);
+    gauge.initialValue = merged.value("value").toDouble(NAN);
+    if (gauge.svgFile.isEmpty())
+        return false;
+    
+    GaugeSpec &spec = gauge.spec;
+    spec.valueMin = merged.value("min").toDouble(spec.valueMin);
+    spec.valueMax = merged.value("max").toDouble(spec.valueMax);
+    spec.angleMin = merged.value("angleMin").toDouble(spec.angleMin);
+    spec.angleMax = merged.value("angleMax").toDouble(spec.angleMax);
+    //Checked before going unsigned, where a negative count would wrap
+    int majorTicks = merged.value("majorTicks").toInt(spec.numMajorTicks);
+    int minorTicks = merged.value("minorTicks").toInt(spec.numMinorTicks);
+    if (majorTicks < 0 || majorTicks > MAX_LAYOUT_TICKS
+        || minorTicks < 0 || minorTicks > MAX_LAYOUT_TICKS)
+        return false;
+    spec.numMajorTicks = majorTicks;
+    spec.numMinorTicks = minorTicks;
+    spec.textColor = QColor(merged.value("textColor").toString("black"));
+    spec.valueLabelPrecision = merged.value("labelPrecision").toInt(
+        spec.valueLabelPrecision);
+    QString format = merged.value("labelFormat").toString();
+    if (!format.isEmpty())
+        spec.valueLabelFormat = format.at(0).toLatin1();
+    spec.topLabel = merged.value("topLabel").toString();
+    spec.bottomLabel = merged.value("bottomLabel").toString();
+    
+    for (const auto &bandValue: merged.value("bands").toArray()) {
+        QJsonArray band = bandValue.toArray();
+        if (band.size() != 3)
+            return false;
+        
+        spec.rangeBands.append({QColor(band[0].toString()),
+                                band[1].toDouble(), band[2].toDouble()});
+    }
+    
+    return spec.valueMin <= spec.valueMax && spec.angleMin <= spec.angleMax;
+}
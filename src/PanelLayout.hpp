@@ -0,0 +1,66 @@
+#ifndef PANELLAYOUT_HPP
+#define PANELLAYOUT_HPP
+
+
+#include "Gauge.hpp"
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include <cmath>
+
+
+#define DEFAULT_PANEL_LAYOUT ":/layouts/default.json"
+
+
+//One gauge and the variable it shows, multiplied by a constant
+struct GaugeLayout
+{
+    bool angular = true;
+    QString svgFile, variable;
+    double scale = 1;
+    double initialValue = NAN;
+    GaugeSpec spec;
+    
+    TickedSvgGauge * create() const;
+};
+
+
+//Gauges stacked in a column, framed under a title unless it is empty
+struct GaugeGroupLayout
+{
+    QString title;
+    QVector<GaugeLayout> gauges;
+};
+
+
+struct PageLayout
+{
+    QString title;
+    QVector<QVector<GaugeGroupLayout>> columns;
+};
+
+
+/* The pages of gauges shown by the main window, read from a JSON file.
+ * The top level object holds "pages", each with a "title" and "columns",
+ * arrays whose entries are either a gauge or a {"group", "gauges"} object.
+ * A gauge has a "type" (angular or linear), "svg", "variable", "scale",
+ * "value", "min", "max", "angleMin", "angleMax", "majorTicks",
+ * "minorTicks", "textColor", "labelFormat", "labelPrecision",
+ * "topLabel", "bottomLabel" and "bands", [color, start, end] triplets.
+ * Keys missing from a gauge are taken from "defaults", which holds one
+ * object per type.
+ */
+class PanelLayout
+{
+public:
+    bool load(const QString &fileName);
+    const QVector<PageLayout> & pages() const {return m_pages;}
+
+protected:
+    QVector<PageLayout> m_pages;
+};
+
+
+#endif // PANELLAYOUT_HPP
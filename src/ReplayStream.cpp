@@ -0,0 +1,196 @@
+#include "ReplayStream.hpp"
+
+#include <QDebug>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+#define REPLAY_SLICE_MSECS 10
+#define MSECS_PER_DAY Q_INT64_C(86400000)
+
+
+static const char * const TIME_LABELS[] = {
+    "hour", "minute", "second", "millisecond"
+};
+
+
+ReplayStream::ReplayStream(const QString &logFileName, double speed,
+                           QObject *parent) :
+    TelemetryStream(QString(), 0, parent),
+    m_speed(speed)
+{
+    m_variables = &m_replayVariables;
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(replayDue()));
+    
+    if (!openReplay(logFileName))
+        qWarning() << "Could not open log for replay" << logFileName;
+}
+
+
+bool
+ReplayStream::openReplay(const QString &logFileName)
+{
+    QString fileName = logFileName;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    
+    //Rotated segments are decompressed to a temporary file first
+    QByteArray magic = file.read(4);
+    file.close();
+    if (magic == COMPRESSED_LOG_MAGIC) {
+        if (!m_decompressed.open()
+            || !decompressLogSegment(fileName, m_decompressed.fileName()))
+            return false;
+        fileName = m_decompressed.fileName();
+        magic = BINARY_LOG_MAGIC;
+    }
+    
+    QStringList labels, units;
+    m_binary = magic == BINARY_LOG_MAGIC;
+    if (m_binary) {
+        if (!m_binaryLog.open(fileName))
+            return false;
+        labels = m_binaryLog.labels();
+        units = m_binaryLog.units();
+    } else {
+        m_textLog.setFileName(fileName);
+        if (!m_textLog.open(QIODevice::ReadOnly | QIODevice::Text))
+            return false;
+        
+        QByteArray header = m_textLog.readLine().trimmed();
+        if (!header.startsWith('%'))
+            return false;
+        for (const auto &label: header.mid(1).split('\t'))
+            labels.append(QString::fromUtf8(label));
+    }
+    
+    if (labels.size() > MAX_FRAME_VARIABLES) {
+        qWarning() << "Too many columns to replay" << labels.size();
+        return false;
+    }
+    
+    //Every column becomes the variable with the same id
+    for (int i = 0; i < labels.size(); i++) {
+        m_replayVariables.add(labels[i], units.value(i));
+        includeInLog(labels[i]);
+    }
+    for (int i = 0; i < 4; i++)
+        m_timeColumns[i] = m_replayVariables.indexOf(TIME_LABELS[i]);
+    
+    m_record.resize(labels.size());
+    return true;
+}
+
+
+void
+ReplayStream::start()
+{
+    if (!isOpen())
+        return;
+    
+    m_haveRecord = readRecord();
+    m_firstTime = m_recordTime;
+    m_clock.start();
+    replayDue();
+}
+
+
+bool
+ReplayStream::readRecord()
+{
+    if (m_binary) {
+        if (!m_binaryLog.readRecord(m_record.data()))
+            return false;
+    } else {
+        QByteArray line = m_textLog.readLine();
+        if (line.isEmpty())
+            return false;
+        
+        QList<QByteArray> fields = line.trimmed().split('\t');
+        for (int i = 0; i < m_record.size(); i++)
+            m_record[i] = (i < fields.size()
+                           ? std::strtod(fields[i].constData(), 0) : NAN);
+    }
+    
+    //Time of day, carried over from the previous record when missing
+    double parts[4];
+    for (int i = 0; i < 4; i++) {
+        parts[i] = m_timeColumns[i] >= 0 ? m_record[m_timeColumns[i]] : NAN;
+        if (std::isnan(parts[i]))
+            return true;
+    }
+    
+    //The millisecond column actually holds a fraction of a second
+    qint64 time = (((qint64) parts[0] * 60 + (qint64) parts[1]) * 60
+                   + (qint64) parts[2]) * 1000 + qRound64(parts[3] * 1000);
+    if (time + m_dayOffset < m_recordTime - MSECS_PER_DAY / 2)
+        m_dayOffset += MSECS_PER_DAY;
+    m_recordTime = time + m_dayOffset;
+    return true;
+}
+
+
+void
+ReplayStream::publishRecord()
+{
+    TelemetryFrame &frame = m_scratchFrame;
+    frame.clear(m_variables);
+    for (int id = 0; id < m_record.size(); id++) {
+        if (!std::isnan(m_record[id]))
+            frame.set(id, m_record[id]);
+    }
+    
+    if (isLoggingOn())
+        logMessage(frame);
+    markChanges(frame);
+    deliverFrame(frame);
+}
+
+
+void
+ReplayStream::replayDue()
+{
+    if (m_speed <= 0) {
+        //As fast as possible, yielding to the event loop every few ms
+        QElapsedTimer slice;
+        slice.start();
+        while (m_haveRecord && slice.elapsed() < REPLAY_SLICE_MSECS) {
+            publishRecord();
+            m_haveRecord = readRecord();
+        }
+    } else {
+        while (m_haveRecord) {
+            qint64 due = (m_recordTime - m_firstTime) / m_speed;
+            qint64 wait = due - m_clock.elapsed();
+            if (wait > 0) {
+                m_timer.start(wait);
+                return;
+            }
+            
+            publishRecord();
+            m_haveRecord = readRecord();
+        }
+    }
+    
+    if (m_haveRecord)
+        m_timer.start(0);
+    else
+        emit finished();
+}
+
+
+bool
+ReplayStream::messageValid(quint8, const char *, int)
+{
+    return false;
+}
+
+
+void
+ReplayStream::parseMessage(const char *, TelemetryFrame &)
+{
+}
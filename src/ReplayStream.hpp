@@ -0,0 +1,59 @@
+#ifndef REPLAYSTREAM_HPP
+#define REPLAYSTREAM_HPP
+
+
+#include "TelemetryStream.hpp"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QVector>
+
+
+/* Plays a text, binary or compressed log back through the TelemetryStream
+ * signals, paced by its hour/minute/second/millisecond columns at the given
+ * speed, or as fast as possible with a speed of 0.
+ */
+class ReplayStream : public TelemetryStream
+{
+    Q_OBJECT
+    
+public:
+    ReplayStream(const QString &logFileName, double speed=1,
+                 QObject *parent=0);
+    bool isOpen() const {return !m_record.isEmpty();}
+    void setSpeed(double speed) {m_speed = speed;}
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+protected:
+    VariableTable m_replayVariables;
+    QFile m_textLog;
+    QTemporaryFile m_decompressed;
+    BinaryLogReader m_binaryLog;
+    bool m_binary = false;
+    int m_timeColumns[4];
+    QVector<double> m_record;
+    bool m_haveRecord = false;
+    qint64 m_recordTime = 0, m_firstTime = 0, m_dayOffset = 0;
+    double m_speed;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    
+    bool openReplay(const QString &logFileName);
+    bool readRecord();
+    void publishRecord();
+    virtual bool messageValid(quint8 checksum, const char *payload, int size);
+    virtual void parseMessage(const char *body, TelemetryFrame &frame);
+
+protected slots:
+    void replayDue();
+};
+
+
+#endif // REPLAYSTREAM_HPP
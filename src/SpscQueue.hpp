@@ -0,0 +1,63 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+
+#include <atomic>
+#include <vector>
+
+
+/* Bounded lock-free queue for exactly one producer and one consumer thread.
+ * Items are written and read in place: the producer fills the slot returned
+ * by beginPush() and publishes it with commitPush(), the consumer reads the
+ * slot returned by front() and releases it with pop().
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity) : m_slots(capacity + 1) {}
+
+    T* beginPush()
+    {
+        int tail = m_tail.load(std::memory_order_relaxed);
+        if (next(tail) == m_head.load(std::memory_order_acquire))
+            return 0;
+
+        return &m_slots[tail];
+    }
+
+    void commitPush()
+    {
+        int tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store(next(tail), std::memory_order_release);
+    }
+
+    T* front()
+    {
+        int head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return 0;
+
+        return &m_slots[head];
+    }
+
+    void pop()
+    {
+        int head = m_head.load(std::memory_order_relaxed);
+        m_head.store(next(head), std::memory_order_release);
+    }
+
+private:
+    std::vector<T> m_slots;
+    std::atomic<int> m_head{0};
+    char m_padding[64]; //Keep head and tail on separate cache lines
+    std::atomic<int> m_tail{0};
+
+    int next(int index) const
+    {
+        return index + 1 == (int) m_slots.size() ? 0 : index + 1;
+    }
+};
+
+
+#endif // SPSCQUEUE_HPP
@@ -0,0 +1,320 @@
+#include "TelemetryLog.hpp"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtEndian>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <string>
+
+
+static void
+appendString(QByteArray &out, const QString &string)
+{
+    QByteArray utf8 = string.toUtf8();
+    quint16 size = qToLittleEndian<quint16>(utf8.size());
+    out.append(reinterpret_cast<const char*>(&size), sizeof size);
+    out.append(utf8);
+}
+
+
+static bool
+readString(QFile &file, QString &string)
+{
+    quint16 size;
+    if (file.read(reinterpret_cast<char*>(&size), sizeof size) != sizeof size)
+        return false;
+    
+    size = qFromLittleEndian(size);
+    QByteArray utf8 = file.read(size);
+    if (utf8.size() != size)
+        return false;
+    
+    string = QString::fromUtf8(utf8);
+    return true;
+}
+
+
+QByteArray
+binaryLogHeader(const QStringList &labels, const QStringList &units)
+{
+    QByteArray header(BINARY_LOG_MAGIC, 4);
+    quint16 version = qToLittleEndian<quint16>(BINARY_LOG_VERSION);
+    quint16 columns = qToLittleEndian<quint16>(labels.size());
+    header.append(reinterpret_cast<const char*>(&version), sizeof version);
+    header.append(reinterpret_cast<const char*>(&columns), sizeof columns);
+    for (int i = 0; i < labels.size(); i++) {
+        appendString(header, labels[i]);
+        appendString(header, units.value(i));
+    }
+    
+    return header;
+}
+
+
+void
+binaryLogRecord(const double *values, int count, char *record)
+{
+    for (int i = 0; i < count; i++) {
+        quint64 bits;
+        std::memcpy(&bits, &values[i], sizeof bits);
+        bits = qToLittleEndian(bits);
+        std::memcpy(record + i * sizeof bits, &bits, sizeof bits);
+    }
+}
+
+
+AsyncLogWriter::AsyncLogWriter(int bufferSize) :
+    m_bufferSize(bufferSize)
+{
+    m_front.reserve(bufferSize);
+    m_back.reserve(bufferSize);
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    close();
+}
+
+
+bool
+AsyncLogWriter::open(const QString &fileName, QIODevice::OpenMode mode,
+                     const LogPolicy &policy)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(mode))
+        return false;
+    
+    m_policy = policy;
+    m_closing = false;
+    m_size = 0;
+    m_running = true;
+    m_thread = std::thread([this]{run();});
+    return true;
+}
+
+
+bool
+AsyncLogWriter::write(const char *data, int size)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_running || m_front.size() + size > m_bufferSize) {
+        m_droppedRecords++;
+        return false;
+    }
+    
+    m_front.append(data, size);
+    m_size += size;
+    
+    //Don't wait for the flush interval once half the buffer is taken
+    if (m_front.size() > m_bufferSize / 2)
+        m_wakeUp.wakeOne();
+    return true;
+}
+
+
+void
+AsyncLogWriter::close()
+{
+    m_mutex.lock();
+    if (!m_running) {
+        m_mutex.unlock();
+        return;
+    }
+    m_closing = true;
+    m_wakeUp.wakeOne();
+    m_mutex.unlock();
+    
+    m_thread.join();
+    m_mutex.lock();
+    m_running = false;
+    m_mutex.unlock();
+    m_file.close();
+}
+
+
+void
+AsyncLogWriter::run()
+{
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+    QElapsedTimer sinceSync;
+    sinceSync.start();
+    
+    QMutexLocker lock(&m_mutex);
+    for (;;) {
+        if (!m_closing && m_front.size() <= m_bufferSize / 2) {
+            if (m_policy.flushInterval > 0)
+                m_wakeUp.wait(&m_mutex, m_policy.flushInterval);
+            else
+                m_wakeUp.wait(&m_mutex);
+        }
+        
+        //Take the filled half and let the producer go on with the other one
+        qSwap(m_front, m_back);
+        bool closing = m_closing;
+        lock.unlock();
+        
+        if (!m_back.isEmpty())
+            m_file.write(m_back);
+        m_back.resize(0);
+        m_file.flush();
+        
+        qint64 syncPeriod = m_policy.syncInterval * Q_INT64_C(1000);
+        if (closing || (syncPeriod > 0 && sinceSync.elapsed() >= syncPeriod)) {
+            sync();
+            sinceSync.restart();
+        }
+        
+        lock.relock();
+        if (closing && m_front.isEmpty())
+            break;
+    }
+}
+
+
+void
+AsyncLogWriter::sync()
+{
+#if defined(Q_OS_WIN)
+    _commit(m_file.handle());
+#else
+    fsync(m_file.handle());
+#endif
+}
+
+
+bool
+BinaryLogReader::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    
+    char magic[4];
+    quint16 version, columns;
+    if (m_file.read(magic, 4) != 4 || std::memcmp(magic, BINARY_LOG_MAGIC, 4)
+        || m_file.read(reinterpret_cast<char*>(&version), 2) != 2
+        || qFromLittleEndian(version) != BINARY_LOG_VERSION
+        || m_file.read(reinterpret_cast<char*>(&columns), 2) != 2)
+        return false;
+    
+    //Empty records would read successfully forever
+    if (columns == 0)
+        return false;
+    
+    m_labels.clear();
+    m_units.clear();
+    for (int i = 0; i < qFromLittleEndian(columns); i++) {
+        QString label, units;
+        if (!readString(m_file, label) || !readString(m_file, units))
+            return false;
+        m_labels.append(label);
+        m_units.append(units);
+    }
+    
+    m_record.resize(columnCount() * sizeof(double));
+    return true;
+}
+
+
+bool
+BinaryLogReader::readRecord(double *values)
+{
+    if (m_file.read(m_record.data(), m_record.size()) != m_record.size())
+        return false;
+    
+    for (int i = 0; i < columnCount(); i++) {
+        quint64 bits;
+        std::memcpy(&bits, m_record.constData() + i * sizeof bits, sizeof bits);
+        bits = qFromLittleEndian(bits);
+        std::memcpy(&values[i], &bits, sizeof bits);
+    }
+    
+    return true;
+}
+
+
+QByteArray
+captureHeader()
+{
+    QByteArray header(CAPTURE_MAGIC, 4);
+    quint16 version = qToLittleEndian<quint16>(CAPTURE_VERSION);
+    header.append(reinterpret_cast<const char*>(&version), sizeof version);
+    
+    return header;
+}
+
+
+void
+appendCaptureChunk(QByteArray &out, qint64 timestamp, const char *data,
+                   int size)
+{
+    qint64 time = qToLittleEndian(timestamp);
+    quint32 count = qToLittleEndian<quint32>(size);
+    out.append(reinterpret_cast<const char*>(&time), sizeof time);
+    out.append(reinterpret_cast<const char*>(&count), sizeof count);
+    out.append(data, size);
+}
+
+
+bool
+CaptureReader::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    
+    return m_file.read(6) == captureHeader();
+}
+
+
+bool
+CaptureReader::readChunk(qint64 &timestamp, QByteArray &data)
+{
+    qint64 time;
+    quint32 count;
+    if (m_file.read(reinterpret_cast<char*>(&time), sizeof time) != sizeof time
+        || m_file.read(reinterpret_cast<char*>(&count), sizeof count)
+           != sizeof count)
+        return false;
+    
+    timestamp = qFromLittleEndian(time);
+    data = m_file.read(qFromLittleEndian(count));
+    return data.size() == (int) qFromLittleEndian(count);
+}
+
+
+QByteArray
+textLogHeader(const QStringList &labels)
+{
+    QByteArray header("%");
+    for (const auto &label: labels) {
+        header.append(label.toUtf8());
+        header.append('\t');
+    }
+    header.append('\n');
+    
+    return header;
+}
+
+
+QByteArray
+textLogRecord(const double *values, int count)
+{
+    QByteArray record;
+    for (int i = 0; i < count; i++) {
+        record.append(std::to_string(values[i]).c_str());
+        record.append('\t');
+    }
+    record.append('\n');
+    
+    return record;
+}
@@ -0,0 +1,125 @@
+#ifndef TELEMETRYLOG_HPP
+#define TELEMETRYLOG_HPP
+
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <thread>
+
+
+#define BINARY_LOG_MAGIC "TLOG"
+#define BINARY_LOG_VERSION 1
+#define LOG_BUFFER_SIZE (256 * 1024)
+#define CAPTURE_MAGIC "TCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_EXTENSION ".tcap"
+
+
+/* Binary log layout, all integers little-endian:
+ *   magic "TLOG", quint16 version, quint16 column count,
+ *   for every column a quint16-length-prefixed UTF-8 label and units,
+ *   then fixed-width records of one IEEE 754 double per column, NaN where
+ *   the frame lacked the variable.
+ */
+QByteArray binaryLogHeader(const QStringList &labels, const QStringList &units);
+void binaryLogRecord(const double *values, int count, char *record);
+
+
+//How long records may stay in memory before being written to the file (ms)
+//and in the OS cache before being synced to the disk (s). With 0 they are
+//written only as the buffer fills up and synced only on close().
+struct LogPolicy
+{
+    int flushInterval = 1000;
+    int syncInterval = 0;
+};
+
+
+/* Writes a log file from its own thread. Records go into the front half of
+ * a pre-allocated double buffer and the thread writes out the back half in
+ * one block. A record that does not fit is dropped and counted, so the
+ * producer never blocks on the disk. Not a QObject, so that a finished
+ * writer may be closed and deleted from any thread.
+ */
+class AsyncLogWriter
+{
+public:
+    explicit AsyncLogWriter(int bufferSize=LOG_BUFFER_SIZE);
+    ~AsyncLogWriter();
+    bool open(const QString &fileName, QIODevice::OpenMode mode,
+              const LogPolicy &policy=LogPolicy());
+    bool write(const char *data, int size);
+    bool write(const QByteArray &data) {return write(data.constData(),
+                                                     data.size());}
+    void close();
+    quint64 droppedRecords() const {return m_droppedRecords;}
+    qint64 size() const {return m_size;}
+    QString fileName() const {return m_file.fileName();}
+
+protected:
+    QFile m_file;
+    qint64 m_size = 0;
+    LogPolicy m_policy;
+    QByteArray m_front, m_back;
+    int m_bufferSize;
+    QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    bool m_running = false, m_closing = false;
+    std::thread m_thread;
+    std::atomic<quint64> m_droppedRecords{0};
+    
+    void run();
+    void sync();
+};
+
+
+class BinaryLogReader
+{
+public:
+    bool open(const QString &fileName);
+    bool readRecord(double *values);
+    int columnCount() const {return m_labels.size();}
+    const QStringList & labels() const {return m_labels;}
+    const QStringList & units() const {return m_units;}
+
+protected:
+    QFile m_file;
+    QStringList m_labels, m_units;
+    QByteArray m_record;
+};
+
+
+/* Raw capture layout, all integers little-endian:
+ *   magic "TCAP", quint16 version,
+ *   then for every chunk read from the port a qint64 monotonic timestamp in
+ *   nanoseconds since the capture started, a quint32 byte count and the
+ *   bytes themselves.
+ */
+QByteArray captureHeader();
+void appendCaptureChunk(QByteArray &out, qint64 timestamp, const char *data,
+                        int size);
+
+
+class CaptureReader
+{
+public:
+    bool open(const QString &fileName);
+    bool readChunk(qint64 &timestamp, QByteArray &data);
+
+protected:
+    QFile m_file;
+};
+
+
+//The tab-separated text log, as written by TelemetryStream
+QByteArray textLogHeader(const QStringList &labels);
+QByteArray textLogRecord(const double *values, int count);
+
+
+#endif // TELEMETRYLOG_HPP
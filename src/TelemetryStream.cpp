@@ -1,21 +1,29 @@
 #include "TelemetryStream.hpp"
 
-#include <QVector>
 #include <QDebug>
+#include <QMetaMethod>
 
 #include <algorithm>
 #include <cmath>
-#include <string>
+#include <cstring>
 
 
-#define EMS_MESSAGE_BODY_SIZE 119
-#define EFIS_MESSAGE_BODY_SIZE 51
 #define MESSAGE_FOOTER_SIZE 2
+#define FRAME_BUFFER_DEPTH 8
+#define FRAME_QUEUE_DEPTH 64
 
 
-static const QString fahrenheit = QString::fromUtf8("\u00B0F");
-static const QString degrees = QString::fromUtf8("\u00B0");
-static const QString degrees_per_second = QString::fromUtf8("\u00B0/s");
+//Variable ids of every field of a schema, -1 where the field has no label
+struct SchemaVariables
+{
+    VariableTable table;
+    QVector<int> labelIds, altLabelIds, generalPurposeIds;
+};
+
+
+static const char * logExtension(TelemetryStream::LogFormat format);
+static const SchemaVariables & emsVariables();
+static const SchemaVariables & efisVariables();
 
 
 TelemetryVariable::operator QString() const
@@ -24,9 +32,165 @@ TelemetryVariable::operator QString() const
 }
 
 
+int
+VariableTable::add(const QString &label, const QString &units)
+{
+    int id = m_labels.size();
+    Q_ASSERT(id < MAX_FRAME_VARIABLES);
+    
+    m_labels.append(label);
+    m_units.append(units);
+    m_ids.insert(label, id);
+    return id;
+}
+
+
+void
+TelemetryFrame::clear(const VariableTable *table)
+{
+    variables = table;
+    present = 0;
+    changed = 0;
+    arrival = 0;
+}
+
+
+void
+TelemetryFrame::set(int id, double value)
+{
+    values[id] = value;
+    present |= Q_UINT64_C(1) << id;
+}
+
+
+TelemetryVariable
+TelemetryFrame::variable(int id) const
+{
+    return TelemetryVariable(variables->label(id), variables->units(id),
+                             values[id]);
+}
+
+
+FrameBuffer::FrameBuffer(int frameSize, int depth) :
+    m_data(depth * (frameSize + MESSAGE_FOOTER_SIZE), '\0'),
+    m_frameSize(frameSize)
+{
+}
+
+
+qint64
+FrameBuffer::fill(QIODevice *device)
+{
+    qint64 total = 0;
+    
+    //Read straight into the free space, which wraps at most once
+    while (m_size < m_data.size()) {
+        int tail = (m_head + m_size) % m_data.size();
+        int contiguous = std::min(m_data.size() - tail, m_data.size() - m_size);
+        qint64 len = device->read(m_data.data() + tail, contiguous);
+        if (len <= 0)
+            break;
+        
+        m_size += len;
+        total += len;
+    }
+    
+    return total;
+}
+
+
+int
+FrameBuffer::append(const char *data, int size)
+{
+    int total = 0;
+    
+    //Copy into the free space, which wraps at most once
+    while (m_size < m_data.size() && total < size) {
+        int tail = (m_head + m_size) % m_data.size();
+        int contiguous = std::min(m_data.size() - tail, m_data.size() - m_size);
+        int len = std::min(contiguous, size - total);
+        std::memcpy(m_data.data() + tail, data + total, len);
+        
+        m_size += len;
+        total += len;
+    }
+    
+    return total;
+}
+
+
+bool
+FrameBuffer::takeFrame(char *frame)
+{
+    forever {
+        int end = findTerminator();
+        if (end < 0) {
+            //A full buffer without any CRLF holds nothing but garbage, keep
+            //only the last byte as it might be the CR of the next marker
+            if (m_size == m_data.size()) {
+                m_discardedBytes += m_size - 1;
+                consume(m_size - 1);
+            }
+            return false;
+        }
+        
+        if (end < m_frameSize) {
+            //Runt line, resynchronize on its CRLF
+            m_discardedBytes += end + MESSAGE_FOOTER_SIZE;
+            consume(end + MESSAGE_FOOTER_SIZE);
+            continue;
+        }
+        
+        //Anything preceding the frame in the same line is garbage
+        m_discardedBytes += end - m_frameSize;
+        consume(end - m_frameSize);
+        for (int i = 0; i < m_frameSize; i++)
+            frame[i] = at(i);
+        consume(m_frameSize + MESSAGE_FOOTER_SIZE);
+        return true;
+    }
+}
+
+
+void
+FrameBuffer::clear()
+{
+    m_head = 0;
+    m_size = 0;
+}
+
+
+char
+FrameBuffer::at(int i) const
+{
+    return m_data.constData()[(m_head + i) % m_data.size()];
+}
+
+
+int
+FrameBuffer::findTerminator() const
+{
+    for (int i = 0; i + 1 < m_size; i++)
+        if (at(i) == '\r' && at(i + 1) == '\n')
+            return i;
+    
+    return -1;
+}
+
+
+void
+FrameBuffer::consume(int len)
+{
+    m_head = (m_head + len) % m_data.size();
+    m_size -= len;
+}
+
+
 TelemetryStream::TelemetryStream(const QString &portName,
                                  int message_body_size, QObject *parent) :
-    QObject(parent), port(portName), message_body_size(message_body_size)
+    QObject(parent), port(portName), message_body_size(message_body_size),
+    m_frameBuffer(message_body_size, FRAME_BUFFER_DEPTH),
+    m_frame(message_body_size, '\0'), m_queue(FRAME_QUEUE_DEPTH)
 {
     total_message_size = message_body_size + MESSAGE_FOOTER_SIZE;
 
@@ -35,473 +199,598 @@ TelemetryStream::TelemetryStream(const QString &portName,
 }
 
 
+TelemetryStream::~TelemetryStream()
+{
+    //Too late for streams with a reader thread, see stopReaderThread()
+    stopReaderThread();
+}
+
+
+void
+TelemetryStream::stopReaderThread()
+{
+    runInReaderThread([this]{
+        stopLogging();
+        stopCapture();
+        port.close();
+        port.moveToThread(thread());
+    });
+    
+    if (m_readerThread) {
+        m_readerThread->quit();
+        m_readerThread->wait();
+        delete m_readerThread;
+        m_readerThread = 0;
+    }
+}
+
+
+void
+TelemetryStream::startReaderThread()
+{
+    if (m_readerThread)
+        return;
+    
+    //Reopen the port in the reader thread, where triggerRead will also run
+    QString portName = port.portName();
+    if (port.isOpen())
+        port.close();
+    
+    m_readerThread = new QThread(this);
+    port.moveToThread(m_readerThread);
+    disconnect(&port, SIGNAL(readyRead()), this, SLOT(triggerRead()));
+    connect(&port, SIGNAL(readyRead()), this, SLOT(triggerRead()),
+            Qt::DirectConnection);
+    m_readerThread->start();
+    
+    setPort(portName);
+}
+
+
+void
+TelemetryStream::runInReaderThread(std::function<void()> task)
+{
+    if (m_readerThread && QThread::currentThread() != m_readerThread)
+        QMetaObject::invokeMethod(&port, task, Qt::BlockingQueuedConnection);
+    else
+        task();
+}
+
+
+void
+TelemetryStream::startLogging(const QString &logFileName, LogFormat format)
+{
+    runInReaderThread([=]{
+        stopLogging();
+        prepareLog(format);
+        openLog(logFileName);
+    });
+}
+
+
+void
+TelemetryStream::startLogging(LogSession *session, const QString &streamName,
+                              LogFormat format)
+{
+    runInReaderThread([=]{
+        stopLogging();
+        prepareLog(format);
+        m_logSession = session;
+        m_logStreamName = streamName;
+        openLog(session->beginSegment(streamName, logExtension(format)));
+    });
+}
+
+
 void
-TelemetryStream::startLogging(const QString &logFileName)
+TelemetryStream::prepareLog(LogFormat format)
 {
-    m_logFile = new QFile(logFileName, this);
-    m_logFile->open(QIODevice::WriteOnly | QIODevice::Text);
+    QStringList labels, units;
+    for (int id: m_logColumns) {
+        labels.append(m_variables->label(id));
+        units.append(m_variables->units(id));
+    }
     
-    auto variableNames = m_logVariables.keys();
-    auto comp = [&](const QString &a, const QString &b){
-        return m_logVariables[a] < m_logVariables[b];
-    };
-    std::sort(variableNames.begin(), variableNames.end(), comp);
+    m_logFormat = format;
+    if (format == BinaryLog)
+        m_logHeader = binaryLogHeader(labels, units);
+    else
+        m_logHeader = textLogHeader(labels);
+}
+
+
+void
+TelemetryStream::openLog(const QString &logFileName)
+{
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if (m_logFormat == TextLog)
+        mode |= QIODevice::Text;
     
-    m_logFile->write("%");
-    for (const auto &name: variableNames) {
-        m_logFile->write(name.toUtf8());
-        m_logFile->write("\t");
+    m_logWriter = new AsyncLogWriter;
+    if (!m_logWriter->open(logFileName, mode, m_logPolicy)) {
+        qWarning() << "Could not open log file" << logFileName;
+        delete m_logWriter;
+        m_logWriter = 0;
+        return;
     }
+    
+    m_logWriter->write(m_logHeader);
+    m_segmentStart = QDateTime::currentDateTime();
+    m_segmentTimer.start();
+}
+
+
+void
+TelemetryStream::rotateLog()
+{
+    //The session closes the finished segment in the background
+    AsyncLogWriter *finished = m_logWriter;
+    QDateTime finishedStart = m_segmentStart;
+    m_droppedLogRecords += finished->droppedRecords();
+    
+    openLog(m_logSession->beginSegment(m_logStreamName,
+                                       logExtension(m_logFormat)));
+    m_logSession->finishSegment(finished, finishedStart);
 }
 
 
 void
 TelemetryStream::stopLogging()
 {
-    delete m_logFile;
+    runInReaderThread([this]{
+        if (!m_logWriter)
+            return;
+        
+        m_droppedLogRecords += m_logWriter->droppedRecords();
+        if (m_logSession)
+            m_logSession->finishSegment(m_logWriter, m_segmentStart);
+        else
+            delete m_logWriter;
+        
+        m_logWriter = 0;
+        m_logSession = 0;
+    });
 }
 
 
 bool
 TelemetryStream::isLoggingOn()
 {
-    return m_logFile != 0;
+    bool loggingOn;
+    runInReaderThread([&]{
+        loggingOn = m_logWriter != 0;
+    });
+    
+    return loggingOn;
+}
+
+
+quint64
+TelemetryStream::droppedLogRecords()
+{
+    quint64 dropped = m_droppedLogRecords;
+    runInReaderThread([&]{
+        if (m_logWriter)
+            dropped += m_logWriter->droppedRecords();
+    });
+    
+    return dropped;
 }
 
 
 void
-TelemetryStream::triggerRead()
+TelemetryStream::startCapture(const QString &captureFileName)
 {
-    //Check if the message end marker (CR + LF) has been reached
-    if (!port.canReadLine())
-	return;
+    runInReaderThread([=]{
+        stopCapture();
+        openCapture(captureFileName);
+    });
+}
+
+
+void
+TelemetryStream::startCapture(LogSession *session, const QString &streamName)
+{
+    runInReaderThread([=]{
+        stopCapture();
+        m_captureSession = session;
+        m_captureStreamName = streamName;
+        openCapture(session->beginSegment(streamName, CAPTURE_EXTENSION));
+    });
+}
+
+
+void
+TelemetryStream::openCapture(const QString &captureFileName)
+{
+    m_captureWriter = new AsyncLogWriter;
+    if (!m_captureWriter->open(captureFileName, QIODevice::WriteOnly,
+                               m_logPolicy)) {
+        qWarning() << "Could not open capture file" << captureFileName;
+        delete m_captureWriter;
+        m_captureWriter = 0;
+        return;
+    }
     
-    //Get the message body
-    QByteArray line = port.readLine();
-    if (line.endsWith("\r\n"))
-        line.chop(2);
-    if (line.size() < message_body_size)
-	return;
-    else if (line.size() > message_body_size)
-	line = line.right(message_body_size);
+    //Every segment has its own header and clock, to be replayed on its own
+    m_captureWriter->write(captureHeader());
+    m_readChunk.resize(total_message_size * FRAME_BUFFER_DEPTH);
+    m_captureStart = QDateTime::currentDateTime();
+    m_captureClock.start();
+}
+
+
+void
+TelemetryStream::rotateCapture()
+{
+    AsyncLogWriter *finished = m_captureWriter;
+    QDateTime finishedStart = m_captureStart;
+    m_droppedCaptureChunks += finished->droppedRecords();
     
-    //Extract the checksum
-    quint8 checksum = line.right(2).toInt(NULL, 16);
-    line.chop(2);
+    openCapture(m_captureSession->beginSegment(m_captureStreamName,
+                                               CAPTURE_EXTENSION));
+    m_captureSession->finishSegment(finished, finishedStart);
+}
+
+
+void
+TelemetryStream::stopCapture()
+{
+    runInReaderThread([this]{
+        if (!m_captureWriter)
+            return;
+        
+        //Dropped chunks leave gaps in what should be a bit-exact capture
+        quint64 dropped = m_captureWriter->droppedRecords();
+        if (dropped)
+            qWarning() << "Capture dropped" << dropped << "chunks of"
+                       << m_captureWriter->fileName();
+        m_droppedCaptureChunks += dropped;
+        
+        if (m_captureSession)
+            m_captureSession->finishSegment(m_captureWriter, m_captureStart);
+        else
+            delete m_captureWriter;
+        
+        m_captureWriter = 0;
+        m_captureSession = 0;
+    });
+}
+
+
+quint64
+TelemetryStream::droppedCaptureChunks()
+{
+    quint64 dropped = m_droppedCaptureChunks;
+    runInReaderThread([&]{
+        if (m_captureWriter)
+            dropped += m_captureWriter->droppedRecords();
+    });
     
-    //Check the message
-    if (!messageValid(checksum, line))
-	return;
+    return dropped;
+}
+
+
+void
+TelemetryStream::ingest(const char *data, int size)
+{
+    //Same framing as the port, whatever the chunk boundaries
+    while (size > 0) {
+        int len = m_frameBuffer.append(data, size);
+        data += len;
+        size -= len;
+        while (m_frameBuffer.takeFrame(m_frame.data()))
+            processFrame(m_frame);
+    }
+}
+
+
+void
+TelemetryStream::captureRead()
+{
+    //All chunks of this readyRead share its arrival time
+    qint64 timestamp = m_captureClock.nsecsElapsed();
+    forever {
+        qint64 len = port.read(m_readChunk.data(), m_readChunk.size());
+        if (len <= 0)
+            break;
+        
+        m_captureChunk.resize(0);
+        appendCaptureChunk(m_captureChunk, timestamp, m_readChunk.constData(),
+                           len);
+        m_captureWriter->write(m_captureChunk);
+        ingest(m_readChunk.constData(), len);
+    }
     
-    TelemetryMessage msg = parseMessage(line);
-    emit messageReceived(msg);
-    for (TelemetryMessage::iterator i = msg.begin(); i != msg.end(); i++)
-	emit variableUpdated(*i);
+    if (m_captureSession
+        && m_captureSession->segmentFull(m_captureWriter->size(),
+                                         m_captureClock.elapsed()))
+        rotateCapture();
+}
 
-    if (isLoggingOn())
-        logMessage(msg);
+
+void
+TelemetryStream::triggerRead()
+{
+    m_readArrival = LatencyTrace::arrival();
+    if (m_captureWriter) {
+        captureRead();
+        return;
+    }
+    
+    readFrom(&port);
 }
 
 
 void
-TelemetryStream::setPort(const QString &portName)
+TelemetryStream::readFrom(QIODevice *device)
 {
-    if (portName.isEmpty())
+    //Drain the device, handling every complete frame (body + CR + LF) on the
+    //way
+    do {
+        m_frameBuffer.fill(device);
+        while (m_frameBuffer.takeFrame(m_frame.data()))
+            processFrame(m_frame);
+    } while (device->bytesAvailable() > 0);
+}
+
+
+void
+TelemetryStream::processFrame(const QByteArray &raw)
+{
+    //Extract the checksum
+    const char *payload = raw.constData();
+    int payload_size = message_body_size - 2;
+    quint8 checksum = decodeHex(payload + payload_size, 2);
+    
+    //Check the message
+    if (!messageValid(checksum, payload, payload_size))
+	return;
+    LatencyTrace::record(ChecksumStage, m_readArrival);
+    
+    //In the reader thread, parse straight into the queue slot handed over to
+    //the GUI thread; a full queue still gets the frame logged before the drop
+    TelemetryFrame *slot = m_readerThread ? m_queue.beginPush() : 0;
+    TelemetryFrame &frame = slot ? *slot : m_scratchFrame;
+    frame.clear(m_variables);
+    parseMessage(payload, frame);
+    frame.arrival = m_readArrival;
+    LatencyTrace::record(ParseStage, m_readArrival);
+    if (isLoggingOn())
+        logMessage(frame);
+    
+    if (m_readerThread && !slot) {
+        m_droppedFrames++;
         return;
+    }
     
-    if (port.isOpen())
-        port.close();
+    markChanges(frame);
+    if (!m_readerThread) {
+        deliverFrame(frame);
+        return;
+    }
+    m_queue.commitPush();
     
-    port.setPortName(portName);
-    port.open(QIODevice::ReadOnly);
-    port.setBaudRate(QSerialPort::Baud115200);
-    port.setReadBufferSize(total_message_size);
+    //Wake the GUI thread only when it has already drained everything queued
+    if (!m_drainPending.exchange(true))
+        QMetaObject::invokeMethod(this, "drainQueue", Qt::QueuedConnection);
 }
 
 
 void
-TelemetryStream::includeInLog(const QString &variableName)
+TelemetryStream::drainQueue()
 {
-    m_logVariables.insert(variableName, m_logVariables.size());
+    m_drainPending = false;
+    while (TelemetryFrame *frame = m_queue.front()) {
+        deliverFrame(*frame);
+        m_queue.pop();
+    }
 }
 
 
 void
-TelemetryStream::logMessage(const TelemetryMessage &message)
+TelemetryStream::markChanges(TelemetryFrame &frame)
 {
-    QVector<double> data(m_logVariables.size(), NAN);
-    
-    for (const auto &variable: message) {
-        auto indexIterator = m_logVariables.find(variable.label);
-        if (indexIterator != m_logVariables.end())
-            data[*indexIterator] = variable.value;
+    //Compare against the last frame handed to the subscribers, so that the
+    //changes of dropped frames are not lost
+    //A sensor stuck at NaN is unchanged, though NaN != NaN
+    quint64 changed = frame.present & ~m_lastFrame.present;
+    for (int id = 0; id < frame.size(); id++) {
+        double value = frame.values[id], last = m_lastFrame.values[id];
+        if (frame.has(id) && m_lastFrame.has(id)
+            && !(value == last || (std::isnan(value) && std::isnan(last))))
+            changed |= Q_UINT64_C(1) << id;
     }
+    frame.changed = changed;
     
-    for (auto datum: data) {
-        m_logFile->write(std::to_string(datum).c_str());
-        m_logFile->write("\t");
+    m_lastFrame.present = frame.present;
+    std::copy(frame.values, frame.values + frame.size(), m_lastFrame.values);
+}
+
+
+void
+TelemetryStream::deliverFrame(const TelemetryFrame &frame)
+{
+    emit frameReceived(frame);
+    
+    //Only build the QString-based variables when someone listens for them
+    static const QMetaMethod variableUpdatedSignal =
+        QMetaMethod::fromSignal(&TelemetryStream::variableUpdated);
+    if (!isSignalConnected(variableUpdatedSignal))
+        return;
+    
+    for (int id = 0; id < frame.size(); id++) {
+        if (frame.has(id))
+            emit variableUpdated(frame.variable(id));
     }
-    m_logFile->write("\n");
 }
 
 
-double
-TelemetryStream::parseDouble(int & cursor, unsigned len,
-                             const QByteArray & body)
+void
+TelemetryStream::setPort(const QString &portName)
 {
+    if (portName.isEmpty())
+        return;
+    
+    runInReaderThread([=]{
+        if (port.isOpen())
+            port.close();
+        m_frameBuffer.clear();
+        
+        port.setPortName(portName);
+        port.open(QIODevice::ReadOnly);
+        port.setBaudRate(QSerialPort::Baud115200);
+        port.setReadBufferSize(0); //Unbounded, triggerRead drains it all
+    });
+}
 
-    bool ok;
-    double value = body.mid(cursor, len).toDouble(&ok);
-    if (!ok)
-	value = NAN;
 
-    cursor += len;
-    return value;
+void
+TelemetryStream::includeInLog(const QString &variableName)
+{
+    int id = m_variables->indexOf(variableName);
+    if (id >= 0 && !m_logColumns.contains(id))
+        m_logColumns.append(id);
 }
 
 
-long
-TelemetryStream::parseHex(int & cursor, unsigned len, const QByteArray & body)
+void
+TelemetryStream::includeInLog(const FieldSpec *schema, int count)
 {
+    for (int i = 0; i < count; i++) {
+        if (schema[i].label)
+            includeInLog(QString::fromUtf8(schema[i].label));
+        if (schema[i].altLabel)
+            includeInLog(QString::fromUtf8(schema[i].altLabel));
+    }
+}
 
-    long value = body.mid(cursor, len).toInt(NULL, 16);
-    cursor += len;
-    return value;
+
+void
+TelemetryStream::logMessage(const TelemetryFrame &frame)
+{
+    double data[MAX_FRAME_VARIABLES];
+    for (int i = 0; i < m_logColumns.size(); i++) {
+        int id = m_logColumns[i];
+        data[i] = frame.has(id) ? frame.values[id] : NAN;
+    }
+    
+    if (m_logFormat == BinaryLog) {
+        char record[MAX_FRAME_VARIABLES * sizeof(double)];
+        binaryLogRecord(data, m_logColumns.size(), record);
+        m_logWriter->write(record, m_logColumns.size() * sizeof(double));
+    } else {
+        m_logWriter->write(textLogRecord(data, m_logColumns.size()));
+    }
+    
+    if (m_logSession && m_logSession->segmentFull(m_logWriter->size(),
+                                                  m_segmentTimer.elapsed()))
+        rotateLog();
 }
 
 
 EmsStream::EmsStream(const QString & portName, QObject *parent) :
     TelemetryStream(portName, EMS_MESSAGE_BODY_SIZE, parent)
 {
-    includeInLog("hour");
-    includeInLog("minute");
-    includeInLog("second");
-    includeInLog("millisecond");
-    includeInLog("manifold pressure");
-    includeInLog("oil temperature");
-    includeInLog("oil pressure");
-    includeInLog("fuel pressure");
-    includeInLog("voltage");
-    includeInLog("current");
-    includeInLog("RPM");
-    includeInLog("fuel flow");
-    includeInLog("remaining fuel");
-    includeInLog("fuel level 1");
-    includeInLog("fuel level 2");
-    includeInLog("general purpose thermocouple");
-    includeInLog("egt1");
-    includeInLog("egt2");
-    includeInLog("egt3");
-    includeInLog("egt4");
-    includeInLog("egt5");
-    includeInLog("egt6");
-    includeInLog("cht1");
-    includeInLog("cht2");
-    includeInLog("cht3");
-    includeInLog("cht4");
-    includeInLog("cht5");
-    includeInLog("cht6");
-    includeInLog("contact 1");
-    includeInLog("contact 2");
+    m_variables = &emsVariables().table;
+    includeInLog(EMS_SCHEMA, EMS_FIELD_COUNT);
+}
+
+
+EmsStream::~EmsStream()
+{
+    //Before the parsing functions go away with this part of the object
+    stopReaderThread();
 }
 
 
 bool
-EmsStream::parseGeneralPurpose(int & cursor, const QByteArray & body, 
-                               TelemetryVariable & var)
-{
-    QByteArray label = body.mid(cursor, 3);
-    cursor += 3;
-    
-    double value = parseDouble(cursor, 5, body);
-    if (label == "OAT") {
-        var.label = "OAT";
-        var.value = value;
-        var.units = fahrenheit;
-    } else if (label == "CRB") {
-        var.label = "carburator temperature";
-        var.value = value;
-        var.units = fahrenheit;
-    } else if (label == "CLT") {
-        var.label = "coolant temperature";
-        var.value = value;
-        var.units = fahrenheit;
-    } else if (label == "CLP") {
-        var.label = "coolant pressure";
-        var.value = value;
-        var.units = "psi";
-    } else if (label == "FL3") {
-        var.label = "fuel level 3";
-        var.value = value / 10;
-        var.units = "gal";
-    } else if (label == "FL4") {
-        var.label = "fuel level 4";
-        var.value = value / 10;
-        var.units = "gal";
-    } else if (label == "CHT") {
-        var.label = "cylinder head temperature";
-        var.value = value;
-        var.units = fahrenheit;
-    } else if (label == "TRA") {
-        var.label = "aileron trim";
-        var.value = value;
-        var.units = "%";
-    } else if (label == "TRE") {
-        var.label = "elevator trim";
-        var.value = value;
-        var.units = "%";
-    } else if (label == "TRR") {
-        var.label = "rudder trim";
-        var.value = value;
-        var.units = "%";
-    } else if (label == "FLP") {
-        var.label = "flap position";
-        var.value = value;
-        var.units = degrees;
-    } else {
+EmsStream::messageValid(quint8 checksum, const char *payload, int size)
+{
+    quint8 sum;
+    if (!sumAndValidate(payload, size, EMS_CHARACTERS, EMS_CHARACTER_RANGES,
+                        sum))
         return false;
-    }
     
-    return true;
+    return (quint8) (checksum + sum) == 0;
 }
 
 
-bool
-EmsStream::messageValid(quint8 checksum, const QByteArray & payload)
-{
-    for (int i = 0; i < payload.size(); i++)
-        checksum += payload[i];
-    return checksum == 0;
-}
-
-
-TelemetryMessage
-EmsStream::parseMessage(const QByteArray & body)
-{
-    TelemetryMessage msg;
-    int cursor = 0;
-    
-    msg.append(
-        TelemetryVariable("hour", "h", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable("minute", "min", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable("second", "s", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable(
-            "millisecond", "ms", parseDouble(cursor, 2, body) / 64
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "manifold pressure", "inHg", parseDouble(cursor, 4, body) / 100
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "oil temperature", fahrenheit, parseDouble(cursor, 3, body)
-        )
-    );
-    msg.append(
-        TelemetryVariable("oil pressure", "PSI", parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable(
-            "fuel pressure", "PSI", parseDouble(cursor, 3, body) / 10
-        )
-    );
-    msg.append(
-        TelemetryVariable("voltage", "V", parseDouble(cursor, 3, body) / 10)
-    );
-    msg.append(
-        TelemetryVariable("current", "A", parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("RPM", "RPM", parseDouble(cursor, 3, body) * 10)
-    );
-    msg.append(
-        TelemetryVariable("fuel flow", "GPH", parseDouble(cursor, 3, body) / 10)
-    );
-    msg.append(
-        TelemetryVariable(
-            "remaining fuel", "gal", parseDouble(cursor, 4, body) / 10
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "fuel level 1", "gal", parseDouble(cursor, 3, body) / 10
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "fuel level 2", "gal", parseDouble(cursor, 3, body) / 10
-        )
-    );
-
-    for (int i = 0; i < 3; i++) {
-        TelemetryVariable gp;
-        if (parseGeneralPurpose(cursor, body, gp))
-            msg.append(gp);
-    }
+void
+EmsStream::parseMessage(const char *body, TelemetryFrame &frame)
+{
+    const SchemaVariables &ids = emsVariables();
     
-    msg.append(
-        TelemetryVariable(
-            "general purpose thermocouple", fahrenheit,
-	    parseDouble(cursor, 4, body)
-        )
-    );
-    msg.append(
-        TelemetryVariable("egt1", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("egt2", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("egt3", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("egt4", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("egt5", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("egt6", fahrenheit, parseDouble(cursor, 4, body))
-    );
-    msg.append(
-        TelemetryVariable("cht1", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("cht2", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("cht3", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("cht4", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("cht5", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("cht6", fahrenheit, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("contact 1", "", parseDouble(cursor, 1, body))
-    );
-    msg.append(
-        TelemetryVariable("contact 2", "", parseDouble(cursor, 1, body))
-    );
-    
-    return msg;
+    double values[EMS_FIELD_COUNT];
+    SchemaDecoder<EMS_SCHEMA, 0, EMS_FIELD_COUNT>::decode(body, values);
+    
+    for (int i = 0; i < EMS_FIELD_COUNT; i++) {
+        const FieldSpec &field = EMS_SCHEMA[i];
+        if (field.kind != FieldSpec::GeneralPurpose) {
+            if (ids.labelIds[i] >= 0)
+                frame.set(ids.labelIds[i], values[i]);
+            continue;
+        }
+        
+        //The first three characters tell which variable the field holds
+        const char *code = body + field.offset;
+        for (int j = 0; j < EMS_GENERAL_PURPOSE_COUNT; j++) {
+            const auto &spec = EMS_GENERAL_PURPOSE[j];
+            if (qstrncmp(code, spec.code, 3) == 0) {
+                frame.set(ids.generalPurposeIds[j],
+                          values[i] * spec.multiplier / spec.divisor);
+                break;
+            }
+        }
+    }
 }
 
 
 EfisStream::EfisStream(const QString & portName, QObject *parent) :
     TelemetryStream(portName, EFIS_MESSAGE_BODY_SIZE, parent)
 {
-    includeInLog("hour");
-    includeInLog("minute");
-    includeInLog("second");
-    includeInLog("millisecond");
-    includeInLog("pitch");
-    includeInLog("roll");
-    includeInLog("yaw");
-    includeInLog("airspeed");
-    includeInLog("lateral acceleration");
-    includeInLog("vertical acceleration");
-    includeInLog("angle of attack");
-    includeInLog("pressure altitude");
-    includeInLog("turn rate");
-    includeInLog("displayed altitude");
-    includeInLog("vertical speed");
+    m_variables = &efisVariables().table;
+    includeInLog(EFIS_SCHEMA, EFIS_FIELD_COUNT);
+}
+
+
+EfisStream::~EfisStream()
+{
+    stopReaderThread();
 }
 
 
 bool
-EfisStream::messageValid(quint8 checksum, const QByteArray & payload)
+EfisStream::messageValid(quint8 checksum, const char *payload, int size)
 {
-    quint8 sum = 0;
-    for (int i = 0; i < payload.size(); i++)
-        sum += payload[i];
+    quint8 sum;
+    if (!sumAndValidate(payload, size, EFIS_CHARACTERS, EFIS_CHARACTER_RANGES,
+                        sum))
+        return false;
     
     return checksum == sum;
 }
 
 
-TelemetryMessage
-EfisStream::parseMessage(const QByteArray & body)
-{
-    TelemetryMessage msg;
-    int cursor = 0;
-    
-    msg.append(
-        TelemetryVariable("hour", "h", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable("minute", "min", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable("second", "s", parseDouble(cursor, 2, body))
-    );
-    msg.append(
-        TelemetryVariable(
-            "millisecond", "ms", parseDouble(cursor, 2, body) / 64
-        )
-    );
-    msg.append(
-        TelemetryVariable("pitch", degrees, parseDouble(cursor, 4, body) / 10)
-    );
-    msg.append(
-        TelemetryVariable("roll", degrees, parseDouble(cursor, 5, body) / 10)
-    );
-    msg.append(
-        TelemetryVariable("yaw", degrees, parseDouble(cursor, 3, body))
-    );
-    msg.append(
-        TelemetryVariable("airspeed", "m/s", parseDouble(cursor, 4, body) / 10)
-    );
-
-    double altitude_alternating = parseDouble(cursor, 5, body);
-    double vsi_alternating = parseDouble(cursor, 4, body) / 10;
-
-    msg.append(
-        TelemetryVariable(
-            "lateral acceleration", "g", parseDouble(cursor, 3, body) / 100
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "vertical acceleration", "g", parseDouble(cursor, 3, body) / 10
-        )
-    );
-    msg.append(
-        TelemetryVariable(
-            "angle of attack", "% of stall", parseDouble(cursor, 2, body)
-        )
-    );
-    
-    int status_bitmask = parseHex(cursor, 6, body);
-    if (status_bitmask & 1) {
-        msg.append(
-            TelemetryVariable("pressure altitude", "m", altitude_alternating)
-        );
-        msg.append(
-            TelemetryVariable("turn rate", degrees_per_second, vsi_alternating)
-        );
-    } else {
-        msg.append(
-            TelemetryVariable("displayed altitude", "m", altitude_alternating)
-        );
-        msg.append(
-            TelemetryVariable("vertical speed", "ft/s", vsi_alternating)
-        );
-    }
+void
+EfisStream::parseMessage(const char *body, TelemetryFrame &frame)
+{
+    const SchemaVariables &ids = efisVariables();
+    
+    double values[EFIS_FIELD_COUNT];
+    SchemaDecoder<EFIS_SCHEMA, 0, EFIS_FIELD_COUNT>::decode(body, values);
+    
+    //The altitude and vertical speed fields alternate between two variables
+    long status_bitmask = values[EFIS_STATUS_FIELD];
+    bool alternate = !(status_bitmask & 1);
     
-    return msg;
+    for (int i = 0; i < EFIS_FIELD_COUNT; i++) {
+        int id = ids.labelIds[i];
+        if (alternate && ids.altLabelIds[i] >= 0)
+            id = ids.altLabelIds[i];
+        if (id >= 0)
+            frame.set(id, values[i]);
+    }
 }
 
 
@@ -516,3 +805,61 @@ TelemetryDump::printVariable(const TelemetryVariable & var)
 {
     stream << (QString) var << endl;
 }
+
+
+static void
+registerSchema(SchemaVariables &vars, const FieldSpec *schema, int count)
+{
+    vars.labelIds.fill(-1, count);
+    vars.altLabelIds.fill(-1, count);
+    for (int i = 0; i < count; i++) {
+        if (schema[i].label)
+            vars.labelIds[i] = vars.table.add(
+                QString::fromUtf8(schema[i].label),
+                QString::fromUtf8(schema[i].units)
+            );
+        if (schema[i].altLabel)
+            vars.altLabelIds[i] = vars.table.add(
+                QString::fromUtf8(schema[i].altLabel),
+                QString::fromUtf8(schema[i].altUnits)
+            );
+    }
+}
+
+
+static const SchemaVariables &
+emsVariables()
+{
+    static const SchemaVariables vars = []{
+        SchemaVariables vars;
+        registerSchema(vars, EMS_SCHEMA, EMS_FIELD_COUNT);
+        for (int i = 0; i < EMS_GENERAL_PURPOSE_COUNT; i++)
+            vars.generalPurposeIds.append(vars.table.add(
+                QString::fromUtf8(EMS_GENERAL_PURPOSE[i].label),
+                QString::fromUtf8(EMS_GENERAL_PURPOSE[i].units)
+            ));
+        return vars;
+    }();
+    
+    return vars;
+}
+
+
+static const SchemaVariables &
+efisVariables()
+{
+    static const SchemaVariables vars = []{
+        SchemaVariables vars;
+        registerSchema(vars, EFIS_SCHEMA, EFIS_FIELD_COUNT);
+        return vars;
+    }();
+    
+    return vars;
+}
+
+
+static const char *
+logExtension(TelemetryStream::LogFormat format)
+{
+    return format == TelemetryStream::BinaryLog ? ".tlog" : ".log";
+}
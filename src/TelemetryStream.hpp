@@ -2,11 +2,24 @@
 #define TELEMETRYSTREAM_HPP
 
 
+#include "FrameSchema.hpp"
+#include "LatencyTrace.hpp"
+#include "LogSession.hpp"
+#include "SpscQueue.hpp"
+
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QList>
+#include <QHash>
+#include <QIODevice>
 #include <QSerialPort>
+#include <QThread>
 #include <QTime>
 #include <QTextStream>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
 
 
 class TelemetryVariable 
@@ -23,7 +36,69 @@ public:
 };
 
 
-typedef QList<TelemetryVariable> TelemetryMessage;
+#define MAX_FRAME_VARIABLES 64
+
+
+/* Labels and units of the variables a stream type can decode, registered
+ * once and referred to by their small integer id everywhere else.
+ */
+class VariableTable
+{
+public:
+    int add(const QString &label, const QString &units);
+    int indexOf(const QString &label) const {return m_ids.value(label, -1);}
+    int size() const {return m_labels.size();}
+    const QString & label(int id) const {return m_labels[id];}
+    const QString & units(int id) const {return m_units[id];}
+
+protected:
+    QVector<QString> m_labels, m_units;
+    QHash<QString, int> m_ids;
+};
+
+
+/* One decoded frame: a dense array of values indexed by variable id, a
+ * bitset of the variables actually present in the frame and a bitset of
+ * those whose value differs from the previous frame of the same stream.
+ * The arrival is the LatencyTrace timestamp of its bytes, 0 when untraced.
+ */
+class TelemetryFrame
+{
+public:
+    const VariableTable *variables = 0;
+    quint64 present = 0;
+    quint64 changed = 0;
+    qint64 arrival = 0;
+    double values[MAX_FRAME_VARIABLES];
+    
+    void clear(const VariableTable *table);
+    void set(int id, double value);
+    bool has(int id) const {return present & (Q_UINT64_C(1) << id);}
+    bool hasChanged(int id) const {return changed & (Q_UINT64_C(1) << id);}
+    int size() const {return variables ? variables->size() : 0;}
+    TelemetryVariable variable(int id) const;
+};
+
+
+class FrameBuffer
+{
+public:
+    FrameBuffer(int frameSize, int depth);
+    qint64 fill(QIODevice *device);
+    int append(const char *data, int size);
+    bool takeFrame(char *frame);
+    void clear();
+    quint64 discardedBytes() const {return m_discardedBytes;}
+
+protected:
+    QByteArray m_data;
+    int m_frameSize, m_head = 0, m_size = 0;
+    quint64 m_discardedBytes = 0;
+
+    char at(int i) const;
+    int findTerminator() const;
+    void consume(int len);
+};
 
     
 class TelemetryStream : public QObject
@@ -33,30 +108,90 @@ class TelemetryStream : public QObject
 public:
     TelemetryStream(const QString &portName, int message_body_size,
                     QObject *parent=0);
-    void startLogging(const QString &logFileName);
+    ~TelemetryStream();
+    enum LogFormat {TextLog, BinaryLog};
+    
+    void startLogging(const QString &logFileName, LogFormat format=TextLog);
+    void startLogging(LogSession *session, const QString &streamName,
+                      LogFormat format=TextLog);
     void stopLogging();
     bool isLoggingOn();
+    void setLogPolicy(const LogPolicy &policy) {m_logPolicy = policy;}
+    quint64 droppedLogRecords();
+    void startCapture(const QString &captureFileName);
+    void startCapture(LogSession *session, const QString &streamName);
+    void stopCapture();
+    quint64 droppedCaptureChunks();
+    bool isCapturing() const {return m_captureWriter != 0;}
+    void ingest(const char *data, int size);
+    void readFrom(QIODevice *device);
+    void startReaderThread();
+    void stopReaderThread();
+    QThread * readerThread() const {return m_readerThread;}
+    quint64 droppedFrames() const {return m_droppedFrames;}
+    const VariableTable * variables() const {return m_variables;}
 
 protected:
     QSerialPort port;
     int message_body_size, total_message_size;
-    QFile *m_logFile = 0;
-    QMap<QString, unsigned> m_logVariables;
+    AsyncLogWriter *m_logWriter = 0;
+    LogFormat m_logFormat = TextLog;
+    LogPolicy m_logPolicy;
+    QByteArray m_logHeader;
+    LogSession *m_logSession = 0;
+    QString m_logStreamName;
+    QDateTime m_segmentStart;
+    QElapsedTimer m_segmentTimer;
+    std::atomic<quint64> m_droppedLogRecords{0};
+    AsyncLogWriter *m_captureWriter = 0;
+    LogSession *m_captureSession = 0;
+    QString m_captureStreamName;
+    QDateTime m_captureStart;
+    std::atomic<quint64> m_droppedCaptureChunks{0};
+    QElapsedTimer m_captureClock;
+    QByteArray m_readChunk, m_captureChunk;
+    const VariableTable *m_variables = 0;
+    QVector<int> m_logColumns;
+    FrameBuffer m_frameBuffer;
+    QByteArray m_frame;
+    qint64 m_readArrival = 0;
+    TelemetryFrame m_scratchFrame;
+    TelemetryFrame m_lastFrame;
+    QThread *m_readerThread = 0;
+    SpscQueue<TelemetryFrame> m_queue;
+    std::atomic<bool> m_drainPending{false};
+    std::atomic<quint64> m_droppedFrames{0};
     
+    void captureRead();
+    void openCapture(const QString &captureFileName);
+    void rotateCapture();
+    void processFrame(const QByteArray &raw);
+    void markChanges(TelemetryFrame &frame);
+    void deliverFrame(const TelemetryFrame &frame);
+    void runInReaderThread(std::function<void()> task);
     void includeInLog(const QString &variableName);
-    void logMessage(const TelemetryMessage &message);
-    double parseDouble(int & cursor, unsigned len, const QByteArray & body);
-    long parseHex(int & cursor, unsigned len, const QByteArray & body);
-    virtual bool messageValid(quint8 checksum, const QByteArray & payload) = 0;
-    virtual TelemetryMessage parseMessage(const QByteArray & body) = 0;
+    void includeInLog(const FieldSpec *schema, int count);
+    void prepareLog(LogFormat format);
+    void openLog(const QString &logFileName);
+    void rotateLog();
+    void logMessage(const TelemetryFrame &frame);
+    virtual bool messageValid(quint8 checksum, const char *payload,
+                              int size) = 0;
+    virtual void parseMessage(const char *body, TelemetryFrame &frame) = 0;
 
 public slots:
     void setPort(const QString &portName);
     void triggerRead();    
 
+private slots:
+    void drainQueue();
+
 signals:
+    //Per-variable compatibility signal, only fed when something connects
     void variableUpdated(const TelemetryVariable & var);
-    void messageReceived(const TelemetryMessage & msg);
+    //The frame lives in the reader queue and is only valid during emission,
+    //receivers must be connected directly in the stream's thread
+    void frameReceived(const TelemetryFrame & frame);
 };
 
 
@@ -66,12 +201,11 @@ class EmsStream : public TelemetryStream
     
 public:
     EmsStream(const QString &portName, QObject *parent=0);
-    bool parseGeneralPurpose(int & cursor, const QByteArray & body, 
-                             TelemetryVariable & var);
-    virtual bool messageValid(quint8 checksum, const QByteArray & payload);
+    ~EmsStream();
+    virtual bool messageValid(quint8 checksum, const char *payload, int size);
 
 protected:
-    virtual TelemetryMessage parseMessage(const QByteArray & body);
+    virtual void parseMessage(const char *body, TelemetryFrame &frame);
 };
 
 
@@ -81,10 +215,11 @@ class EfisStream : public TelemetryStream
     
 public:
     EfisStream(const QString &portName, QObject *parent=0);
-    virtual bool messageValid(quint8 checksum, const QByteArray & payload);
+    ~EfisStream();
+    virtual bool messageValid(quint8 checksum, const char *payload, int size);
 
 protected:
-    virtual TelemetryMessage parseMessage(const QByteArray & body);
+    virtual void parseMessage(const char *body, TelemetryFrame &frame);
 };
 
 
@@ -1,12 +1,33 @@
 #include "MainWindow.hpp"
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     Q_INIT_RESOURCE(AppResources);
 
     QApplication a(argc, argv);
-    MainWindow w;
+    
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption efisReplayOption("replay-efis",
+                                        "Play back an EFIS log.", "log");
+    QCommandLineOption emsReplayOption("replay-ems",
+                                       "Play back an EMS log.", "log");
+    QCommandLineOption speedOption("replay-speed",
+                                   "Replay speed, 0 for maximum.", "factor",
+                                   "1");
+    parser.addOption(efisReplayOption);
+    parser.addOption(emsReplayOption);
+    parser.addOption(speedOption);
+    parser.process(a);
+    
+    ReplaySettings replay;
+    replay.efisLog = parser.value(efisReplayOption);
+    replay.emsLog = parser.value(emsReplayOption);
+    replay.speed = parser.value(speedOption).toDouble();
+    
+    MainWindow w(0, replay);
     w.show();
     
     return a.exec();
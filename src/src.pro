@@ -5,7 +5,13 @@ CONFIG += c++11
 TARGET = telemetry
 TEMPLATE = app
 
-SOURCES += main.cpp MainWindow.cpp TelemetryStream.cpp Gauge.cpp
-HEADERS += MainWindow.hpp TelemetryStream.hpp Gauge.hpp
+SOURCES += main.cpp MainWindow.cpp TelemetryStream.cpp Gauge.cpp \
+           FrameValidation.cpp TelemetryLog.cpp LogSession.cpp \
+           ReplayStream.cpp CaptureReplay.cpp LatencyTrace.cpp \
+           PanelLayout.cpp
+HEADERS += MainWindow.hpp TelemetryStream.hpp Gauge.hpp SpscQueue.hpp \
+           FrameSchema.hpp FrameValidation.hpp TelemetryLog.hpp \
+           LogSession.hpp ReplayStream.hpp CaptureReplay.hpp LatencyTrace.hpp \
+           PanelLayout.hpp
 
 RESOURCES += AppResources.qrc
@@ -0,0 +1,9 @@
+QT += core
+
+INCLUDEPATH += ../../src
+
+TARGET = logconvert
+TEMPLATE = app
+
+SOURCES += main.cpp ../../src/TelemetryLog.cpp ../../src/LogSession.cpp
+HEADERS += ../../src/TelemetryLog.hpp ../../src/LogSession.hpp
@@ -0,0 +1,65 @@
+#include "LogSession.hpp"
+#include "TelemetryLog.hpp"
+
+#include <QtCore>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTextStream>
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication coreApplication(argc, argv);
+    QTextStream standardOutput(stdout);
+
+    // Get and check command-line arguments
+    QStringList arguments = QCoreApplication::arguments();
+    if (arguments.size() != 3) {
+        QString msg("Usage: %1 <binary log[%2]> <text log>");
+        standardOutput << msg.arg(arguments.first())
+            .arg(COMPRESSED_LOG_EXTENSION) << endl;
+        return 1;
+    }
+    
+    // Decompress rotated segments first
+    QString inputName = arguments.at(1);
+    QTemporaryFile decompressed;
+    if (inputName.endsWith(COMPRESSED_LOG_EXTENSION)) {
+        if (!decompressed.open()
+            || !decompressLogSegment(inputName, decompressed.fileName())) {
+            QString msg("Error: cannot decompress '%1'");
+            standardOutput << msg.arg(inputName) << endl;
+            return 1;
+        }
+        inputName = decompressed.fileName();
+    }
+    
+    BinaryLogReader reader;
+    if (!reader.open(inputName)) {
+        QString msg("Error: '%1' is not a binary telemetry log");
+        standardOutput << msg.arg(arguments.at(1)) << endl;
+        return 1;
+    }
+    
+    QFile output(arguments.at(2));
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QString msg("Error: cannot write '%1'");
+        standardOutput << msg.arg(arguments.at(2)) << endl;
+        return 1;
+    }
+    
+    // Convert record by record
+    QVector<double> record(reader.columnCount());
+    bool written = output.write(textLogHeader(reader.labels())) >= 0;
+    while (written && reader.readRecord(record.data()))
+        written = output.write(textLogRecord(record.constData(),
+                                             record.size())) >= 0;
+    
+    if (!written || !output.flush()) {
+        QString msg("Error: cannot write '%1'");
+        standardOutput << msg.arg(arguments.at(2)) << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include "FrameGenerator.hpp"
+#include "TelemetryStream.hpp"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <atomic>
+#include <cstddef>
+#include <random>
+
+
+#define DISTINCT_FRAMES 1024
+#define CHECK_PAYLOADS 100000
+#define CHECK_MAX_SIZE 200
+
+
+static std::atomic<quint64> allocations{0};
+
+
+#ifdef __GLIBC__
+//Qt containers allocate with malloc and realloc rather than operator new,
+//which itself calls malloc. glibc lets the executable interpose them and
+//still reach its own implementation
+static const bool countingAllocations = true;
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+
+
+void *
+malloc(std::size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+
+void *
+calloc(std::size_t count, std::size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+
+void *
+realloc(void *p, std::size_t size)
+{
+    allocations++;
+    return __libc_realloc(p, size);
+}
+}
+#else
+static const bool countingAllocations = false;
+#endif
+
+
+//Exposes the parsers, which are protected in the streams
+class BenchEmsStream : public EmsStream
+{
+public:
+    BenchEmsStream() : EmsStream(QString()) {}
+    using EmsStream::parseMessage;
+};
+
+
+class BenchEfisStream : public EfisStream
+{
+public:
+    BenchEfisStream() : EfisStream(QString()) {}
+    using EfisStream::parseMessage;
+};
+
+
+struct Measurement
+{
+    QElapsedTimer timer;
+    quint64 startAllocations;
+    
+    Measurement() : startAllocations(allocations) {timer.start();}
+    
+    QJsonObject result(const char *protocol, const char *stage, int frames)
+    {
+        qint64 ns = timer.nsecsElapsed();
+        quint64 allocated = allocations - startAllocations;
+        
+        QJsonObject result;
+        result["protocol"] = protocol;
+        result["stage"] = stage;
+        result["frames"] = frames;
+        result["ns_per_frame"] = (double) ns / frames;
+        result["frames_per_second"] = frames * 1e9 / ns;
+        if (countingAllocations)
+            result["allocations_per_frame"] = (double) allocated / frames;
+        else
+            result["allocations_per_frame"] = QJsonValue();
+        return result;
+    }
+};
+
+
+//Byte at a time reference for the vector paths of sumAndValidate
+static bool
+scalarSumAndValidate(const char *data, int size, const CharRange *ranges,
+                     int numRanges, quint8 &sum)
+{
+    quint8 total = 0;
+    for (int i = 0; i < size; i++) {
+        bool allowed = false;
+        for (int r = 0; r < numRanges; r++)
+            allowed = allowed || (data[i] >= ranges[r].first &&
+                                  data[i] <= ranges[r].last);
+        if (!allowed)
+            return false;
+        total += (quint8) data[i];
+    }
+    
+    sum = total;
+    return true;
+}
+
+
+/* Check that sumAndValidate agrees with the scalar reference on random
+ * payloads of every length up to a few vectors, mostly built from allowed
+ * characters with the occasional arbitrary byte, high bit set included.
+ */
+static int
+checkValidation(const char *protocol, const CharRange *ranges, int numRanges)
+{
+    QByteArray allowed;
+    for (int r = 0; r < numRanges; r++)
+        for (int c = ranges[r].first; c <= ranges[r].last; c++)
+            allowed.append((char) c);
+    
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> sizes(0, CHECK_MAX_SIZE);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::uniform_int_distribution<int> choices(0, allowed.size() - 1);
+    std::uniform_int_distribution<int> strays(0, 4 * CHECK_MAX_SIZE);
+    
+    int mismatches = 0;
+    QByteArray payload;
+    for (int i = 0; i < CHECK_PAYLOADS; i++) {
+        payload.resize(sizes(random));
+        for (int j = 0; j < payload.size(); j++) {
+            if (strays(random) == 0)
+                payload[j] = (char) bytes(random);
+            else
+                payload[j] = allowed[choices(random)];
+        }
+        
+        quint8 sum = 0, expectedSum = 0;
+        bool valid = sumAndValidate(payload.constData(), payload.size(),
+                                    ranges, numRanges, sum);
+        bool expectedValid = scalarSumAndValidate(payload.constData(),
+                                                  payload.size(), ranges,
+                                                  numRanges, expectedSum);
+        if (valid != expectedValid || (valid && sum != expectedSum))
+            mismatches++;
+    }
+    
+    if (mismatches != 0)
+        qWarning() << protocol << "validation differs from the scalar path on"
+                   << mismatches << "of" << CHECK_PAYLOADS << "payloads";
+    return mismatches;
+}
+
+
+template <class Stream>
+static void
+benchmark(const char *protocol, FrameGenerator::StreamType type, int frames,
+          QJsonArray &results)
+{
+    Stream stream;
+    FrameGenerator generator(type);
+    int bodySize = generator.frameSize() - 2;
+    int payloadSize = bodySize - MESSAGE_CHECKSUM_SIZE;
+    
+    QVector<QByteArray> distinct;
+    for (int i = 0; i < DISTINCT_FRAMES; i++)
+        distinct.append(generator.frame(i * 0.1));
+    
+    //Checksum and character validation
+    int valid = 0;
+    Measurement validation;
+    for (int i = 0; i < frames; i++) {
+        const char *payload = distinct[i % DISTINCT_FRAMES].constData();
+        quint8 checksum = decodeHex(payload + payloadSize, 2);
+        valid += stream.messageValid(checksum, payload, payloadSize);
+    }
+    results.append(validation.result(protocol, "messageValid", frames));
+    if (valid != frames)
+        qWarning() << protocol << "rejected" << frames - valid << "frames";
+    
+    //Field decoding into a frame
+    TelemetryFrame frame;
+    double sink = 0;
+    Measurement parsing;
+    for (int i = 0; i < frames; i++) {
+        frame.clear(stream.variables());
+        stream.parseMessage(distinct[i % DISTINCT_FRAMES].constData(), frame);
+        sink += frame.values[0];
+    }
+    results.append(parsing.result(protocol, "parseMessage", frames));
+    
+    //The whole read path, framing included, from an in-memory device
+    QByteArray bytes;
+    bytes.reserve(frames * generator.frameSize());
+    for (int i = 0; i < frames; i++)
+        bytes.append(distinct[i % DISTINCT_FRAMES]);
+    QBuffer device(&bytes);
+    device.open(QIODevice::ReadOnly);
+    
+    Measurement reading;
+    stream.readFrom(&device);
+    results.append(reading.result(protocol, "readFrom", frames));
+    
+    if (sink == 42)
+        qDebug() << "Unlikely sink value";
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication coreApplication(argc, argv);
+    QTextStream standardOutput(stdout);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("EMS and EFIS parser benchmark");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Frames per measurement.",
+                                    "count", "200000");
+    QCommandLineOption outputOption("output", "JSON output file.", "file");
+    parser.addOption(framesOption);
+    parser.addOption(outputOption);
+    parser.process(coreApplication);
+    
+    int frames = parser.value(framesOption).toInt();
+    if (frames <= 0) {
+        standardOutput << "Error: bad frame count" << endl;
+        return 1;
+    }
+    
+    if (checkValidation("ems", EMS_CHARACTERS, EMS_CHARACTER_RANGES) +
+        checkValidation("efis", EFIS_CHARACTERS, EFIS_CHARACTER_RANGES) != 0)
+        return 1;
+    
+    QJsonArray results;
+    benchmark<BenchEmsStream>("ems", FrameGenerator::Ems, frames, results);
+    benchmark<BenchEfisStream>("efis", FrameGenerator::Efis, frames, results);
+    
+    QJsonObject report;
+    report["benchmark"] = "parser";
+    report["qt_version"] = qVersion();
+#if defined(__AVX2__)
+    report["simd"] = "avx2";
+#elif defined(__SSE2__)
+    report["simd"] = "sse2";
+#else
+    report["simd"] = "none";
+#endif
+    report["results"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+    
+    QString outputName = parser.value(outputOption);
+    if (outputName.isEmpty()) {
+        standardOutput << json;
+        return 0;
+    }
+    
+    QFile output(outputName);
+    if (!output.open(QIODevice::WriteOnly) || output.write(json) < 0) {
+        standardOutput << "Error: cannot write " << outputName << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+QT += core serialport
+
+CONFIG += c++11
+
+INCLUDEPATH += ../../src ../simulator
+
+TARGET = parserbench
+TEMPLATE = app
+
+SOURCES += main.cpp ../simulator/FrameGenerator.cpp \
+           ../../src/TelemetryStream.cpp ../../src/FrameValidation.cpp \
+           ../../src/TelemetryLog.cpp ../../src/LogSession.cpp \
+           ../../src/LatencyTrace.cpp
+HEADERS += ../simulator/FrameGenerator.hpp ../../src/TelemetryStream.hpp \
+           ../../src/TelemetryLog.hpp ../../src/LogSession.hpp \
+           ../../src/LatencyTrace.hpp
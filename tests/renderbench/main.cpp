@@ -0,0 +1,343 @@
+#include "Gauge.hpp"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGraphicsSimpleTextItem>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QTextStream>
+
+
+//Exposes the moving items, to repaint only what setValue touched, and
+//whether the static layers are rasterized for the current size
+class BenchAngularGauge : public AngularSvgGauge
+{
+public:
+    using AngularSvgGauge::AngularSvgGauge;
+    using AngularSvgGauge::rasterCurrent;
+    
+    QRectF movingRect() const
+    {
+        QRectF rect = m_needle->sceneBoundingRect();
+        if (m_valueLabel)
+            rect |= m_valueLabel->sceneBoundingRect();
+        return rect;
+    }
+};
+
+
+class BenchLinearGauge : public LinearSvgGauge
+{
+public:
+    using LinearSvgGauge::LinearSvgGauge;
+    using LinearSvgGauge::rasterCurrent;
+    
+    QRectF movingRect() const
+    {
+        return m_cursor->sceneBoundingRect()
+            | m_valueLabel->sceneBoundingRect();
+    }
+};
+
+
+struct GaugeCase
+{
+    const char *svgFile;
+    bool angular;
+};
+
+
+//Every gauge image, the deluxe ones included although they still lack
+//elements the gauges need: those are reported as unsupported for the gauge
+//timings and only their SVG document is timed
+static const GaugeCase gaugeCases[] = {
+    {":/images/angular-gauge.svg", true},
+    {":/images/top-circle-gauge.svg", true},
+    {":/images/angular-gauge-deluxe.svg", true},
+    {":/images/horizontal-gauge.svg", false},
+    {":/images/linear-horizontal-gauge-deluxe.svg", false},
+    {":/images/linear-vertical-gauge-deluxe.svg", false},
+};
+
+static const int gaugeWidths[] = {160, 320, 640};
+
+static const char * const angularElementIds[] = {
+    "needle", "majorTick", "tickLabel", "valueLabel", "rangeBand"
+};
+static const char * const linearElementIds[] = {
+    "cursor", "cursorRange", "majorTick", "tickLabel", "valueLabel"
+};
+
+
+//Elements of the kind of gauge the image does not have
+static QJsonArray
+missingElements(const GaugeCase &gaugeCase)
+{
+    QSharedPointer<SvgDocument> svg = SvgDocument::load(gaugeCase.svgFile);
+    QJsonArray missing;
+    auto check = [&](const char *elementId) {
+        if (!svg->renderer()->elementExists(elementId))
+            missing.append(elementId);
+    };
+    
+    if (gaugeCase.angular) {
+        for (auto elementId: angularElementIds)
+            check(elementId);
+    } else {
+        for (auto elementId: linearElementIds)
+            check(elementId);
+    }
+    return missing;
+}
+
+
+static GaugeSpec
+benchSpec()
+{
+    GaugeSpec spec;
+    spec.valueMax = 100;
+    spec.angleMin = -135;
+    spec.angleMax = 90;
+    spec.numMajorTicks = 11;
+    spec.numMinorTicks = 3;
+    spec.textColor = QColor("white");
+    spec.rangeBands = {{QColor("darkgreen"), 0, 80},
+                       {QColor("goldenrod"), 80, 90},
+                       {QColor("darkred"), 90, 100}};
+    spec.bottomLabel = "Bench";
+    spec.topLabel = "unit";
+    return spec;
+}
+
+
+static BenchAngularGauge *
+makeAngularGauge(const QString &svgFile)
+{
+    auto gauge = new BenchAngularGauge(svgFile);
+    gauge->configure(benchSpec());
+    return gauge;
+}
+
+
+static BenchLinearGauge *
+makeLinearGauge(const QString &svgFile)
+{
+    auto gauge = new BenchLinearGauge(svgFile);
+    gauge->configure(benchSpec());
+    return gauge;
+}
+
+
+//Lets the background rasterization of the static layers finish
+template <class Gauge>
+static void
+settle(Gauge *gauge, QWidget *widget, QImage &image)
+{
+    widget->render(&image);
+    if (!gauge->layeredRendering())
+        return;
+    
+    QElapsedTimer timer;
+    timer.start();
+    while (!gauge->rasterCurrent() && timer.elapsed() < 5000)
+        QApplication::processEvents(QEventLoop::AllEvents, 10);
+}
+
+
+template <class Gauge>
+static void
+measureRepaints(Gauge *gauge, int width, int iterations, QJsonObject &result)
+{
+    QSize size(width, width * gauge->sceneRect().height()
+               / gauge->sceneRect().width());
+    gauge->resize(size);
+    gauge->show();
+    QApplication::processEvents();
+    
+    //QGraphicsView::render paints the scene, the widget is what gets shown
+    QWidget *widget = gauge;
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    QElapsedTimer timer;
+    settle(gauge, widget, image);
+    
+    //setValue alone, without painting anything
+    timer.start();
+    for (int i = 0; i < iterations; i++)
+        gauge->setValue(i % 101);
+    result["set_value_ns"] = (double) timer.nsecsElapsed() / iterations;
+    
+    //Whole widget, as after a resize or an expose
+    timer.start();
+    for (int i = 0; i < iterations; i++) {
+        image.fill(Qt::transparent);
+        widget->render(&image);
+    }
+    result["full_repaint_us"] = timer.nsecsElapsed() / 1e3 / iterations;
+    
+    //Only what a value change invalidates, alternating between two values
+    qint64 nsecs = 0;
+    for (int i = 0; i < iterations; i++) {
+        QRectF dirty = gauge->movingRect();
+        gauge->setValue(i % 2 ? 30 : 70);
+        dirty |= gauge->movingRect();
+        QRegion region(gauge->mapFromScene(dirty).boundingRect()
+                       .adjusted(-1, -1, 1, 1));
+        
+        timer.start();
+        widget->render(&image, QPoint(), region);
+        nsecs += timer.nsecsElapsed();
+    }
+    result["partial_repaint_us"] = nsecs / 1e3 / iterations;
+    
+    //A resize drag, a pixel larger each repaint, before anything settles
+    timer.start();
+    for (int i = 1; i <= iterations; i++) {
+        gauge->resize(size + QSize(i % 20, i % 20));
+        widget->render(&image);
+    }
+    result["resize_repaint_us"] = timer.nsecsElapsed() / 1e3 / iterations;
+    gauge->resize(size);
+    
+    result["width"] = size.width();
+    result["height"] = size.height();
+}
+
+
+//Parsing and a full render of the image alone, for the unsupported gauges
+static void
+measureDocument(const GaugeCase &gaugeCase, const QJsonArray &missing,
+                int iterations, QJsonArray &results)
+{
+    int loads = qMax(1, iterations / 20);
+    for (int width: gaugeWidths) {
+        QJsonObject result;
+        result["gauge"] = gaugeCase.svgFile;
+        result["supported"] = false;
+        result["missing_elements"] = missing;
+        
+        //Nothing else holds the document, so each load parses the file
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < loads; i++)
+            SvgDocument::load(gaugeCase.svgFile);
+        result["load_us"] = timer.nsecsElapsed() / 1e3 / loads;
+        
+        QSharedPointer<SvgDocument> svg = SvgDocument::load(gaugeCase.svgFile);
+        QRectF viewBox = svg->viewBox();
+        QSize size(width, width * viewBox.height() / viewBox.width());
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        
+        timer.start();
+        for (int i = 0; i < iterations; i++) {
+            image.fill(Qt::transparent);
+            QPainter painter(&image);
+            svg->renderer()->render(&painter, QRectF(image.rect()));
+        }
+        result["svg_render_us"] = timer.nsecsElapsed() / 1e3 / iterations;
+        
+        result["width"] = size.width();
+        result["height"] = size.height();
+        results.append(result);
+    }
+}
+
+
+template <class Gauge>
+static void
+benchmark(Gauge *(*make)(const QString &), const QString &svgFile,
+          bool layered, int iterations, QJsonArray &results)
+{
+    int constructions = qMax(1, iterations / 20);
+    for (int width: gaugeWidths) {
+        QJsonObject result;
+        result["gauge"] = svgFile;
+        
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < constructions; i++)
+            delete make(svgFile);
+        result["construct_us"] = timer.nsecsElapsed() / 1e3 / constructions;
+        
+        Gauge *gauge = make(svgFile);
+        gauge->setLayeredRendering(layered);
+        measureRepaints(gauge, width, iterations, result);
+        delete gauge;
+        
+        results.append(result);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    //Rendering into images needs no display, nor should it depend on one
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    
+    Q_INIT_RESOURCE(AppResources);
+    QApplication application(argc, argv);
+    QTextStream standardOutput(stdout);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gauge rendering benchmark");
+    parser.addHelpOption();
+    QCommandLineOption iterationsOption("iterations",
+                                        "Repetitions per measurement.",
+                                        "count", "200");
+    QCommandLineOption outputOption("output", "JSON output file.", "file");
+    QCommandLineOption flatOption("flat", "Disable layered rendering.");
+    parser.addOption(iterationsOption);
+    parser.addOption(outputOption);
+    parser.addOption(flatOption);
+    parser.process(application);
+    
+    int iterations = parser.value(iterationsOption).toInt();
+    if (iterations <= 0) {
+        standardOutput << "Error: bad iteration count" << endl;
+        return 1;
+    }
+    
+    bool layered = !parser.isSet(flatOption);
+    QJsonArray results;
+    for (const auto &gaugeCase: gaugeCases) {
+        QJsonArray missing = missingElements(gaugeCase);
+        if (!missing.isEmpty()) {
+            measureDocument(gaugeCase, missing, iterations, results);
+            continue;
+        }
+        
+        if (gaugeCase.angular)
+            benchmark(makeAngularGauge, gaugeCase.svgFile, layered,
+                      iterations, results);
+        else
+            benchmark(makeLinearGauge, gaugeCase.svgFile, layered,
+                      iterations, results);
+    }
+    
+    QJsonObject report;
+    report["benchmark"] = "render";
+    report["qt_version"] = qVersion();
+    report["platform"] = QGuiApplication::platformName();
+    report["iterations"] = iterations;
+    report["layered"] = layered;
+    report["results"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+    
+    QString outputName = parser.value(outputOption);
+    if (outputName.isEmpty()) {
+        standardOutput << json;
+        return 0;
+    }
+    
+    QFile output(outputName);
+    if (!output.open(QIODevice::WriteOnly) || output.write(json) < 0) {
+        standardOutput << "Error: cannot write " << outputName << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT += core gui widgets svg
+
+CONFIG += c++11
+
+INCLUDEPATH += ../../src
+
+TARGET = renderbench
+TEMPLATE = app
+
+SOURCES += main.cpp ../../src/Gauge.cpp ../../src/LatencyTrace.cpp
+HEADERS += ../../src/Gauge.hpp ../../src/LatencyTrace.hpp
+
+RESOURCES += ../../src/AppResources.qrc
@@ -0,0 +1,176 @@
+#include "FrameGenerator.hpp"
+
+#include <QStringList>
+#include <QTime>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+FrameGenerator::FrameGenerator(StreamType type) :
+    m_type(type)
+{
+    if (type == Ems) {
+        m_schema = EMS_SCHEMA;
+        m_fieldCount = EMS_FIELD_COUNT;
+        m_bodySize = EMS_MESSAGE_BODY_SIZE;
+    } else {
+        m_schema = EFIS_SCHEMA;
+        m_fieldCount = EFIS_FIELD_COUNT;
+        m_bodySize = EFIS_MESSAGE_BODY_SIZE;
+    }
+}
+
+
+//Parse "<label>=<constant|sine|ramp|noise>:<min>:<max>[:<period>]"
+bool
+FrameGenerator::setProfile(const QString &spec)
+{
+    int equals = spec.lastIndexOf('=');
+    if (equals <= 0)
+        return false;
+    
+    QStringList parts = spec.mid(equals + 1).split(':');
+    if (parts.size() < 3 || parts.size() > 4)
+        return false;
+    
+    static const QStringList shapes = {"constant", "sine", "ramp", "noise"};
+    Profile profile;
+    int shape = shapes.indexOf(parts[0]);
+    if (shape < 0)
+        return false;
+    
+    profile.shape = (Profile::Shape) shape;
+    profile.min = parts[1].toDouble();
+    profile.max = parts[2].toDouble();
+    if (parts.size() == 4)
+        profile.period = parts[3].toDouble();
+    
+    m_profiles.insert(spec.left(equals), profile);
+    return true;
+}
+
+
+double
+FrameGenerator::value(const QString &label, double fullScale, int index,
+                      double time)
+{
+    //By default sweep half the field's range, each field out of phase
+    Profile profile;
+    profile.max = fullScale / 2;
+    double phase = index * 0.7;
+    auto i = m_profiles.find(label);
+    if (i != m_profiles.end()) {
+        profile = i.value();
+        phase = 0;
+    }
+    
+    double span = profile.max - profile.min;
+    double cycle = profile.period > 0 ? time / profile.period : 0;
+    switch (profile.shape) {
+    case Profile::Constant:
+        return profile.min;
+    case Profile::Ramp:
+        return profile.min + span * (cycle - std::floor(cycle));
+    case Profile::Noise:
+        return (profile.min + span * std::uniform_real_distribution<double>()
+                (m_random));
+    default:
+        return (profile.min + span
+                * (0.5 + 0.5 * std::sin(2 * M_PI * cycle + phase)));
+    }
+}
+
+
+QByteArray
+FrameGenerator::frame(double time)
+{
+    QByteArray frame(m_bodySize + 2, '0');
+    char *payload = frame.data();
+    QTime now = QTime::currentTime();
+    int generalPurposeSlot = 0;
+    m_frameCount++;
+    
+    for (int i = 0; i < m_fieldCount; i++) {
+        const FieldSpec &field = m_schema[i];
+        char *out = payload + field.offset;
+        long raw;
+        
+        switch (field.kind) {
+        case FieldSpec::Hex:
+            //EFIS status, bit 0 alternating between the two variable sets
+            encodeHex(out, field.width, m_frameCount & 1);
+            break;
+        case FieldSpec::GeneralPurpose: {
+            const auto &gp = EMS_GENERAL_PURPOSE[generalPurposeSlot++];
+            std::copy(gp.code, gp.code + 3, out);
+            raw = std::lround(value(gp.label, 1000, i, time)
+                              * gp.divisor / gp.multiplier);
+            encodeDecimal(out + 3, field.width - 3, raw);
+            break;
+        }
+        case FieldSpec::Decimal:
+            if (i == 0)
+                raw = now.hour();
+            else if (i == 1)
+                raw = now.minute();
+            else if (i == 2)
+                raw = now.second();
+            else if (i == 3)
+                raw = now.msec() * 64 / 1000;
+            else {
+                double fullScale = (std::pow(10.0, field.width) - 1)
+                    * field.multiplier / field.divisor;
+                const char *label = (field.altLabel && !(m_frameCount & 1)
+                                     ? field.altLabel : field.label);
+                raw = std::lround(value(label, fullScale, i, time)
+                                  * field.divisor / field.multiplier);
+            }
+            encodeDecimal(out, field.width, raw);
+            break;
+        default:
+            break;
+        }
+    }
+    
+    //EMS checksums cancel the payload sum, EFIS ones equal it
+    int payloadSize = m_bodySize - MESSAGE_CHECKSUM_SIZE;
+    quint8 sum = 0;
+    for (int i = 0; i < payloadSize; i++)
+        sum += payload[i];
+    encodeHex(payload + payloadSize, 2, m_type == Ems ? (quint8) -sum : sum);
+    
+    frame[m_bodySize] = '\r';
+    frame[m_bodySize + 1] = '\n';
+    return frame;
+}
+
+
+//Zero padded, with a leading '-' for negative values, clamped to the width
+void
+encodeDecimal(char *field, int width, long value)
+{
+    bool negative = value < 0;
+    int digits = negative ? width - 1 : width;
+    long limit = std::lround(std::pow(10.0, digits)) - 1;
+    value = std::min(std::labs(value), limit);
+    
+    for (int i = width - 1; i >= width - digits; i--) {
+        field[i] = '0' + value % 10;
+        value /= 10;
+    }
+    if (negative)
+        field[0] = '-';
+}
+
+
+void
+encodeHex(char *field, int width, long value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    for (int i = width - 1; i >= 0; i--) {
+        field[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FRAMEGENERATOR_HPP
+#define FRAMEGENERATOR_HPP
+
+
+#include "FrameSchema.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <random>
+
+
+//Shape of the synthetic values of one variable over time (s)
+struct Profile
+{
+    enum Shape {Constant, Sine, Ramp, Noise};
+    
+    Shape shape = Sine;
+    double min = 0, max = 0, period = 10;
+};
+
+
+/* Builds well-formed EMS or EFIS frames, CRLF included, from the frame
+ * schemas, with values following per-variable synthetic profiles.
+ */
+class FrameGenerator
+{
+public:
+    enum StreamType {Ems, Efis};
+    
+    explicit FrameGenerator(StreamType type);
+    bool setProfile(const QString &spec);
+    QByteArray frame(double time);
+    int frameSize() const {return m_bodySize + 2;}
+
+protected:
+    StreamType m_type;
+    const FieldSpec *m_schema;
+    int m_fieldCount, m_bodySize;
+    QHash<QString, Profile> m_profiles;
+    quint64 m_frameCount = 0;
+    std::mt19937 m_random;
+    
+    double value(const QString &label, double fullScale, int index,
+                 double time);
+};
+
+
+void encodeDecimal(char *field, int width, long value);
+void encodeHex(char *field, int width, long value);
+
+
+#endif // FRAMEGENERATOR_HPP
@@ -0,0 +1,98 @@
+#include "Simulator.hpp"
+
+#include <errno.h>
+#include <unistd.h>
+
+
+#define MAX_BURST 1000
+
+
+Simulator::Simulator(FrameGenerator::StreamType type, double rate,
+                     int masterFd) :
+    generator(type),
+    m_rate(rate),
+    m_masterFd(masterFd)
+{
+    //Frames due are computed from the elapsed time, so that rates above the
+    //timer resolution are written in small bursts
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(qBound(1, (int) (1000 / rate), 1000));
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+    m_clock.start();
+    m_timer.start();
+}
+
+
+bool
+Simulator::chance(double probability)
+{
+    return std::uniform_real_distribution<double>()(m_random) < probability;
+}
+
+
+void
+Simulator::send(const QByteArray &bytes)
+{
+    //Nobody reading the slave side fills the pty: drop rather than block,
+    //but only whole writes, the rest of a frame the pty took in part
+    //going out before anything else
+    if (!flushPending()) {
+        m_dropped++;
+        return;
+    }
+    
+    m_pending = bytes;
+    flushPending();
+}
+
+
+bool
+Simulator::flushPending()
+{
+    while (!m_pending.isEmpty()) {
+        ssize_t written = write(m_masterFd, m_pending.constData(),
+                                m_pending.size());
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                m_pending.clear();
+            return false;
+        }
+        
+        m_pending.remove(0, written);
+    }
+    
+    return true;
+}
+
+
+void
+Simulator::tick()
+{
+    double time = m_clock.nsecsElapsed() * 1e-9;
+    quint64 due = time * m_rate;
+    flushPending();
+    
+    for (int burst = 0; m_sent < due && burst < MAX_BURST; burst++) {
+        QByteArray frame = generator.frame(time);
+        m_sent++;
+        
+        if (chance(noise)) {
+            QByteArray garbage(1 + m_random() % 16, ' ');
+            for (int i = 0; i < garbage.size(); i++)
+                garbage[i] = 0x20 + m_random() % 0x5F;
+            send(garbage);
+        }
+        if (chance(badChecksum))
+            frame[frame.size() - 3] = frame[frame.size() - 3] == '0' ? '1' : '0';
+        if (chance(partial))
+            frame.truncate(m_random() % (frame.size() - 2));
+        
+        send(frame);
+    }
+    
+    //Never fall behind by more than a burst
+    if (m_sent < due)
+        m_sent = due;
+}
@@ -0,0 +1,46 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+
+#include "FrameGenerator.hpp"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+#include <random>
+
+
+/* Writes frames to the master side of a pty at a fixed rate, injecting the
+ * requested faults, while a TelemetryStream reads the slave side.
+ */
+class Simulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    Simulator(FrameGenerator::StreamType type, double rate, int masterFd);
+    quint64 sent() const {return m_sent;}
+    quint64 dropped() const {return m_dropped;}
+    FrameGenerator generator;
+    double noise = 0, partial = 0, badChecksum = 0;
+
+public slots:
+    void tick();
+
+protected:
+    double m_rate;
+    int m_masterFd;
+    quint64 m_sent = 0, m_dropped = 0;
+    QByteArray m_pending;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    std::mt19937 m_random;
+    
+    bool chance(double probability);
+    void send(const QByteArray &bytes);
+    bool flushPending();
+};
+
+
+#endif // SIMULATOR_HPP
@@ -0,0 +1,141 @@
+#include "Simulator.hpp"
+
+#include <QtCore>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTextStream>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+static int signalPipe[2];
+
+
+static void
+quitOnSignal(int)
+{
+    //Only async-signal-safe calls here, the event loop does the rest
+    char byte = 0;
+    if (write(signalPipe[1], &byte, 1) < 0)
+        return;
+}
+
+
+static int
+openPty(QString &slaveName, int &slaveFd)
+{
+    int masterFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (masterFd < 0 || grantpt(masterFd) < 0 || unlockpt(masterFd) < 0)
+        return -1;
+    
+    slaveName = QString::fromLocal8Bit(ptsname(masterFd));
+    
+    //Keep the slave open in raw mode, so the pty survives reader restarts
+    slaveFd = open(ptsname(masterFd), O_RDWR | O_NOCTTY);
+    if (slaveFd < 0)
+        return -1;
+    
+    struct termios attributes;
+    tcgetattr(slaveFd, &attributes);
+    cfmakeraw(&attributes);
+    tcsetattr(slaveFd, TCSANOW, &attributes);
+    return masterFd;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication coreApplication(argc, argv);
+    QTextStream standardOutput(stdout);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Simulated Dynon EMS or EFIS serial port");
+    parser.addHelpOption();
+    QCommandLineOption typeOption("type", "Stream type, ems or efis.",
+                                  "type", "ems");
+    QCommandLineOption rateOption("rate", "Frames per second.", "hz", "10");
+    QCommandLineOption profileOption(
+        "profile", "Variable profile, <label>="
+        "<constant|sine|ramp|noise>:<min>:<max>[:<period s>].", "spec"
+    );
+    QCommandLineOption noiseOption("noise",
+                                   "Probability of garbage before a frame.",
+                                   "p", "0");
+    QCommandLineOption partialOption("partial",
+                                     "Probability of a truncated frame.",
+                                     "p", "0");
+    QCommandLineOption checksumOption("bad-checksum",
+                                      "Probability of a wrong checksum.",
+                                      "p", "0");
+    QCommandLineOption linkOption("link", "Symlink to the slave device.",
+                                  "path");
+    parser.addOption(typeOption);
+    parser.addOption(rateOption);
+    parser.addOption(profileOption);
+    parser.addOption(noiseOption);
+    parser.addOption(partialOption);
+    parser.addOption(checksumOption);
+    parser.addOption(linkOption);
+    parser.process(coreApplication);
+    
+    QString type = parser.value(typeOption);
+    double rate = parser.value(rateOption).toDouble();
+    if ((type != "ems" && type != "efis") || rate <= 0) {
+        standardOutput << "Error: bad stream type or rate" << endl;
+        return 1;
+    }
+    
+    // Open the pty pair
+    QString slaveName;
+    int slaveFd;
+    int masterFd = openPty(slaveName, slaveFd);
+    if (masterFd < 0) {
+        standardOutput << "Error: cannot open a pty" << endl;
+        return 1;
+    }
+    
+    QString link = parser.value(linkOption);
+    if (!link.isEmpty()) {
+        QFile::remove(link);
+        QFile::link(slaveName, link);
+    }
+    
+    Simulator simulator(type == "ems" ? FrameGenerator::Ems
+                        : FrameGenerator::Efis, rate, masterFd);
+    simulator.noise = parser.value(noiseOption).toDouble();
+    simulator.partial = parser.value(partialOption).toDouble();
+    simulator.badChecksum = parser.value(checksumOption).toDouble();
+    for (const auto &spec: parser.values(profileOption)) {
+        if (!simulator.generator.setProfile(spec)) {
+            standardOutput << "Error: bad profile '" << spec << "'" << endl;
+            return 1;
+        }
+    }
+    
+    //Interrupting the simulator still reports what it sent and dropped
+    if (pipe(signalPipe) == 0) {
+        auto notifier = new QSocketNotifier(signalPipe[0],
+                                            QSocketNotifier::Read,
+                                            &coreApplication);
+        QObject::connect(notifier, SIGNAL(activated(int)),
+                         &coreApplication, SLOT(quit()));
+        signal(SIGINT, quitOnSignal);
+        signal(SIGTERM, quitOnSignal);
+    }
+    
+    standardOutput << "Writing " << type << " frames at " << rate
+                   << " Hz to " << (link.isEmpty() ? slaveName : link) << endl;
+    int result = coreApplication.exec();
+    standardOutput << simulator.sent() << " frames due, "
+                   << simulator.dropped() << " dropped" << endl;
+    close(slaveFd);
+    close(masterFd);
+    return result;
+}
+
@@ -0,0 +1,11 @@
+QT += core
+
+CONFIG += c++11
+
+INCLUDEPATH += ../../src
+
+TARGET = simulator
+TEMPLATE = app
+
+SOURCES += main.cpp Simulator.cpp FrameGenerator.cpp
+HEADERS += Simulator.hpp FrameGenerator.hpp ../../src/FrameSchema.hpp
@@ -1,3 +1,5 @@
+#include "CaptureReplay.hpp"
+#include "ReplayStream.hpp"
 #include "TelemetryStream.hpp"
 
 #include <QtCore>
@@ -14,15 +16,22 @@ int main(int argc, char *argv[])
 
     // Get and check command-line arguments
     QStringList arguments = QCoreApplication::arguments();    
-    if (arguments.size() != 3) {
-	QString msg("Usage: %1 <serialportname> <ems|efis>");
+    if (arguments.size() < 3 || arguments.size() > 4) {
+	QString msg("Usage: %1 <serialportname> <ems|efis> [capturefile]\n"
+                    "       %1 <capturefile> <ems|efis>-replay [speed]\n"
+                    "       %1 <logfile> replay [speed]\n"
+                    "A speed of 0 replays as fast as possible.");
 	
         standardOutput << msg.arg(arguments.first()) << endl;
         return 1;
     }
     QString portName = arguments.at(1);
     QString streamType = arguments.at(2);
-    if (streamType != "ems" && streamType != "efis") {
+    bool captureReplay = streamType.endsWith("-replay");
+    if (captureReplay)
+        streamType.chop(7);
+    if (streamType != "ems" && streamType != "efis"
+        && streamType != "replay") {
         QString msg("Error: unknown stream type '%1'");
         standardOutput << msg.arg(streamType)  << endl;
         return 1;
@@ -30,10 +39,27 @@ int main(int argc, char *argv[])
     
     // Create the objects
     TelemetryStream *stream;
-    if (arguments.at(2) == "ems") {
-        stream = new EmsStream(portName);
+    double speed = arguments.size() == 4 ? arguments.at(3).toDouble() : 1;
+    QString streamPort = captureReplay ? QString() : portName;
+    if (streamType == "ems") {
+        stream = new EmsStream(streamPort);
+    } else if (streamType == "efis") {
+        stream = new EfisStream(streamPort);
     } else {
-        stream = new EfisStream(portName);
+        auto replay = new ReplayStream(portName, speed);
+        QObject::connect(replay, SIGNAL(finished()),
+                         &coreApplication, SLOT(quit()));
+        QTimer::singleShot(0, replay, SLOT(start()));
+        stream = replay;
+    }
+    
+    if (captureReplay) {
+        auto replay = new CaptureReplay(portName, stream, speed);
+        QObject::connect(replay, SIGNAL(finished()),
+                         &coreApplication, SLOT(quit()));
+        QTimer::singleShot(0, replay, SLOT(start()));
+    } else if (streamType != "replay" && arguments.size() == 4) {
+        stream->startCapture(arguments.at(3));
     }
     TelemetryDump dump;
     QObject::connect(stream, 
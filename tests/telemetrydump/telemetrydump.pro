@@ -5,5 +5,10 @@ INCLUDEPATH += ../../src
 TARGET = telemetrydump
 TEMPLATE = app
 
-SOURCES += main.cpp ../../src/TelemetryStream.cpp
-HEADERS += ../../src/TelemetryStream.hpp
+SOURCES += main.cpp ../../src/TelemetryStream.cpp \
+           ../../src/FrameValidation.cpp ../../src/TelemetryLog.cpp \
+           ../../src/LogSession.cpp ../../src/LatencyTrace.cpp \
+           ../../src/ReplayStream.cpp ../../src/CaptureReplay.cpp
+HEADERS += ../../src/TelemetryStream.hpp ../../src/TelemetryLog.hpp \
+           ../../src/LogSession.hpp ../../src/LatencyTrace.hpp \
+           ../../src/ReplayStream.hpp ../../src/CaptureReplay.hpp
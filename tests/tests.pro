@@ -1,3 +1,4 @@
 TEMPLATE = subdirs
 
-SUBDIRS += telemetrydump
+SUBDIRS += telemetrydump logconvert parserbench renderbench
+unix:!macx: SUBDIRS += simulator